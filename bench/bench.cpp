@@ -0,0 +1,508 @@
+/**
+ * boogie_bench: throughput of the public hashing entry points.
+ *
+ * Every case reports MB/s, cycles/byte (TSC cycles, x86 only) and heap allocations per call.
+ * `--json` prints one JSON object per line so runs can be diffed between releases.
+ *
+ *   boogie_bench [--json] [--quick] [--max-size BYTES] [--filter SUBSTRING]
+ */
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <hash/cdc.h>
+#include <hash/hmac_sha1.h>
+#include <hash/pbkdf2_sha1.h>
+#include <hash/sha1.h>
+#include <hash/sha1_tree.h>
+#include <hash/sha256.h>
+#include <util/counting_new.h>
+#include <util/file.h>
+
+// Every heap allocation in the process goes through here so each case can report allocations per call.
+namespace {
+    std::atomic<uint64_t> allocations = 0;
+}
+
+void utils::on_allocation() noexcept {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    using namespace hash;
+
+    struct Config {
+        bool json = false;
+        bool quick = false;
+        uint64_t max_size = 256ull << 20;
+        std::string filter;
+        double min_seconds = 0.25;
+    };
+
+    struct Result {
+        std::string name;
+        std::string backend;
+        uint64_t bytes_per_call;
+        uint64_t calls;
+        double seconds;
+        std::optional<double> cycles;
+        uint64_t allocations;
+        uint64_t iterations_per_call = 0; // Only for key derivation, reported as iterations/s
+    };
+
+    std::optional<uint64_t> cycles_now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::nullopt;
+#endif
+    }
+
+    // Keeps the optimiser from dropping a digest nobody looks at.
+    volatile uint32_t sink;
+
+    void consume(const std::array<uint32_t, 5>& raw_hash) {
+        sink = sink + raw_hash[0];
+    }
+
+    void consume(const std::string& hex) {
+        sink = sink + static_cast<uint32_t>(hex[0]);
+    }
+
+    void consume(const sha1::Digest& digest) {
+        sink = sink + std::to_integer<uint32_t>(digest[0]);
+    }
+
+    void consume(const sha256::Digest& digest) {
+        sink = sink + std::to_integer<uint32_t>(digest[0]);
+    }
+
+    void consume(size_t count) {
+        sink = sink + static_cast<uint32_t>(count);
+    }
+
+    /**
+     * Calls `fn` until at least `min_seconds` have passed (and at least once) and reports
+     * the per-call averages. `setup`, when given, runs before every call and is not timed.
+     */
+    Result measure(const Config& config, const std::string& name, uint64_t bytes_per_call,
+                   const std::function<void()>& fn, const std::function<void()>& setup = {}) {
+        if (!setup) {
+            fn(); // Warm up caches, page in buffers, settle the backend choice
+        }
+
+        Result r{name, std::string(sha1::backend_name(sha1::active_backend())), bytes_per_call, 0, 0.0, 0.0, 0};
+        uint64_t allocs_before = allocations.load();
+        double cycles_total = 0;
+        while (r.calls == 0 || r.seconds < config.min_seconds) {
+            if (setup) {
+                setup();
+            }
+            auto c0 = cycles_now();
+            auto t0 = Clock::now();
+            fn();
+            auto t1 = Clock::now();
+            auto c1 = cycles_now();
+            r.seconds += std::chrono::duration<double>(t1 - t0).count();
+            if (c0 && c1) {
+                cycles_total += static_cast<double>(*c1 - *c0);
+            }
+            r.calls++;
+        }
+        r.allocations = allocations.load() - allocs_before;
+        if (cycles_now()) {
+            r.cycles = cycles_total;
+        } else {
+            r.cycles.reset();
+        }
+        return r;
+    }
+
+    void report(const Config& config, const Result& r) {
+        const double total_bytes = static_cast<double>(r.bytes_per_call) * r.calls;
+        const double mb_per_s = total_bytes / r.seconds / 1e6;
+        const double allocs_per_call = static_cast<double>(r.allocations) / r.calls;
+        const double ns_per_call = r.seconds * 1e9 / r.calls;
+        std::optional<double> cycles_per_byte;
+        if (r.cycles && total_bytes > 0) {
+            cycles_per_byte = *r.cycles / total_bytes;
+        }
+
+        char iterations[64] = "";
+        if (r.iterations_per_call > 0) {
+            const double per_s = static_cast<double>(r.iterations_per_call) * r.calls / r.seconds;
+            std::snprintf(iterations, sizeof(iterations), config.json ? ",\"iterations_per_s\":%.0f" : " %.0f it/s", per_s);
+        }
+
+        char line[512];
+        if (config.json) {
+            std::snprintf(line, sizeof(line),
+                          "{\"case\":\"%s\",\"backend\":\"%s\",\"bytes\":%llu,\"calls\":%llu,\"ns_per_call\":%.1f,"
+                          "\"mb_per_s\":%.2f,\"cycles_per_byte\":%s,\"allocs_per_call\":%.2f%s}",
+                          r.name.c_str(), r.backend.c_str(), static_cast<unsigned long long>(r.bytes_per_call),
+                          static_cast<unsigned long long>(r.calls), ns_per_call, mb_per_s,
+                          cycles_per_byte ? std::to_string(*cycles_per_byte).c_str() : "null", allocs_per_call,
+                          iterations);
+        } else {
+            std::snprintf(line, sizeof(line), "%-34s %-9s %12llu B %12.1f ns %10.2f MB/s %8s c/B %6.2f allocs%s",
+                          r.name.c_str(), r.backend.c_str(), static_cast<unsigned long long>(r.bytes_per_call),
+                          ns_per_call, mb_per_s,
+                          cycles_per_byte ? std::to_string(*cycles_per_byte).substr(0, 7).c_str() : "n/a",
+                          allocs_per_call, iterations);
+        }
+        std::cout << line << std::endl;
+    }
+
+    bool wanted(const Config& config, const std::string& name) {
+        return config.filter.empty() || name.find(config.filter) != std::string::npos;
+    }
+
+    std::vector<uint64_t> message_sizes(const Config& config) {
+        std::vector<uint64_t> sizes = {0, 1, 55, 64, 1 << 10, 64 << 10, 1 << 20, 16 << 20, 256 << 20};
+        for (uint64_t gb = 1ull << 30; gb <= config.max_size; gb *= 4) {
+            sizes.push_back(gb);
+        }
+        std::erase_if(sizes, [&](uint64_t s) { return s > config.max_size; });
+        return sizes;
+    }
+
+    std::string size_label(uint64_t bytes) {
+        if (bytes >= (1ull << 30) && bytes % (1ull << 30) == 0) {
+            return std::to_string(bytes >> 30) + "G";
+        }
+        if (bytes >= (1ull << 20) && bytes % (1ull << 20) == 0) {
+            return std::to_string(bytes >> 20) + "M";
+        }
+        if (bytes >= (1ull << 10) && bytes % (1ull << 10) == 0) {
+            return std::to_string(bytes >> 10) + "K";
+        }
+        return std::to_string(bytes);
+    }
+
+    std::string make_input(uint64_t size) {
+        std::string s(size, '\0');
+        uint32_t x = 0x9E3779B9;
+        for (char& c : s) {
+            x = x * 1664525 + 1013904223;
+            c = static_cast<char>(x >> 24);
+        }
+        return s;
+    }
+
+    void bench_one_shot(const Config& config, const std::string& input) {
+        for (uint64_t size : message_sizes(config)) {
+            const std::string name = "hash_string/" + size_label(size);
+            if (!wanted(config, name)) {
+                continue;
+            }
+            const std::string message = input.substr(0, size);
+            report(config, measure(config, name, size, [&] { consume(sha1::hash_string(message)); }));
+        }
+    }
+
+    void bench_streaming(const Config& config, const std::string& input) {
+        const uint64_t size = std::min<uint64_t>(input.size(), config.quick ? (1 << 20) : (64 << 20));
+        const auto bytes = std::as_bytes(std::span(input.data(), size));
+
+        for (size_t chunk : {size_t{64}, size_t{1000}, sha1::CHUNK_SIZE, size_t{64 << 10}, size_t{1 << 20}}) {
+            const std::string name = "update/chunk=" + size_label(chunk) + "/" + size_label(size);
+            if (!wanted(config, name)) {
+                continue;
+            }
+            report(config, measure(config, name, size, [&] {
+                sha1::Hasher hasher;
+                for (size_t pos = 0; pos < bytes.size(); pos += chunk) {
+                    hasher.update(bytes.subspan(pos, std::min(chunk, bytes.size() - pos)));
+                }
+                consume(hasher.finalize());
+            }));
+        }
+
+        const std::string name = "hash_stream/istringstream/" + size_label(size);
+        if (wanted(config, name)) {
+            const std::string message = input.substr(0, size);
+            report(config, measure(config, name, size, [&] {
+                std::istringstream iss(message);
+                consume(sha1::hash_stream_raw(iss));
+            }));
+        }
+    }
+
+    void drop_page_cache(const std::string& path) {
+#ifdef POSIX_FADV_DONTNEED
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+#else
+        (void)path;
+#endif
+    }
+
+    void bench_file(const Config& config, const std::string& input) {
+        const uint64_t size = std::min<uint64_t>(input.size(), config.quick ? (4 << 20) : (256 << 20));
+        const auto path = (std::filesystem::temp_directory_path() / ("boogie_bench_" + std::to_string(getpid()))).string();
+        std::ofstream(path, std::ios::binary).write(input.data(), static_cast<std::streamsize>(size));
+
+        const auto original = utils::active_read_method();
+        for (auto method : {utils::ReadMethod::Map, utils::ReadMethod::Uring, utils::ReadMethod::Thread}) {
+            if (!utils::set_read_method(method)) {
+                continue;
+            }
+            const std::string label = std::string(utils::read_method_name(method)) + "/" + size_label(size);
+            const std::string warm = "hash_file/warm/" + label;
+            if (wanted(config, warm)) {
+                report(config, measure(config, warm, size, [&] { consume(sha1::hash_file(path)); }));
+            }
+            // Best effort: asks the kernel to evict the file before every run. Filesystems that ignore
+            // the hint (tmpfs, some network mounts) will report warm numbers here.
+            const std::string cold = "hash_file/cold/" + label;
+            if (wanted(config, cold)) {
+                report(config, measure(config, cold, size, [&] { consume(sha1::hash_file(path)); },
+                                       [&] { drop_page_cache(path); }));
+            }
+        }
+        utils::set_read_method(original);
+        std::filesystem::remove(path);
+    }
+
+    void bench_batch(const Config& config, const std::string& input) {
+        const size_t count = config.quick ? 1024 : 65536;
+        for (size_t len : {size_t{20}, size_t{55}, size_t{100}, size_t{300}}) {
+            std::vector<std::span<const std::byte>> messages;
+            for (size_t i = 0; i < count; i++) {
+                messages.push_back(std::as_bytes(std::span(input.data() + (i * 7) % 4096, len)));
+            }
+            std::vector<sha1::Digest> digests(count);
+
+            const auto original = sha1::active_batch_backend();
+            for (auto b : {sha1::BatchBackend::Scalar, sha1::BatchBackend::Avx2, sha1::BatchBackend::Avx512}) {
+                const std::string name = "hash_many/" + std::string(sha1::backend_name(b)) + "/"
+                                         + std::to_string(count) + "x" + std::to_string(len);
+                if (!wanted(config, name) || !sha1::set_backend(b)) {
+                    continue;
+                }
+                report(config, measure(config, name, count * len, [&] {
+                    sha1::hash_many(messages, digests);
+                    consume(digests[0]);
+                }));
+            }
+            sha1::set_backend(original);
+        }
+    }
+
+    // Per-message cost of HMAC once the key midstates exist, the case high-rate request signing cares about.
+    void bench_hmac(const Config& config, const std::string& input) {
+        const hmac_sha1::Key key(std::string_view(input).substr(0, 32));
+        for (size_t len : {size_t{32}, size_t{256}, size_t{4096}}) {
+            const std::string name = "hmac_sha1/sign/" + size_label(len);
+            if (!wanted(config, name)) {
+                continue;
+            }
+            const auto message = std::as_bytes(std::span(input.data(), len));
+            report(config, measure(config, name, len, [&] { consume(key.sign(message)); }));
+        }
+    }
+
+    /**
+     * PBKDF2 as a login path (one WPA2-sized key) and as a cracker-style batch of passwords. Bytes
+     * count the two compressed blocks per iteration; iterations/s is the number that matters.
+     */
+    void bench_pbkdf2(const Config& config, const std::string& input) {
+        const uint32_t iterations = config.quick ? 64 : 4096;
+        const auto salt = std::as_bytes(std::span(input.data(), 16));
+        for (size_t passwords : {size_t{1}, size_t{64}}) {
+            std::vector<std::array<std::byte, 32>> keys(passwords);
+            std::vector<pbkdf2_sha1::Request> requests;
+            for (size_t i = 0; i < passwords; i++) {
+                requests.push_back({std::as_bytes(std::span(input.data() + i, 12)), salt, keys[i]});
+            }
+            const auto original = sha1::active_batch_backend();
+            for (auto b : {sha1::BatchBackend::Scalar, sha1::BatchBackend::Avx2, sha1::BatchBackend::Avx512}) {
+                const std::string name = "pbkdf2_sha1/" + std::string(sha1::backend_name(b)) + "/"
+                                         + std::to_string(passwords) + "x32B/c=" + std::to_string(iterations);
+                if (!wanted(config, name) || !sha1::set_backend(b)) {
+                    continue;
+                }
+                // Two output blocks per 32-byte key, two compressions per iteration and block.
+                Result r = measure(config, name, passwords * 2 * iterations * 2 * sha1::SHA1_BLOCK_BYTES, [&] {
+                    pbkdf2_sha1::derive_many(requests, iterations);
+                    consume(sha1::Digest{keys[0][0]});
+                });
+                r.iterations_per_call = passwords * 2 * iterations;
+                report(config, r);
+            }
+            sha1::set_backend(original);
+        }
+    }
+
+    // sha1-tree on one input at increasing worker counts, to show how it scales with cores.
+    void bench_tree(const Config& config, const std::string& input) {
+        const uint64_t size = std::min<uint64_t>(input.size(), config.quick ? (4 << 20) : (256 << 20));
+        const auto bytes = std::as_bytes(std::span(input.data(), size));
+        for (unsigned threads = 1; threads <= std::max(1u, std::thread::hardware_concurrency()); threads *= 2) {
+            const std::string name = "sha1_tree/threads=" + std::to_string(threads) + "/" + size_label(size);
+            if (!wanted(config, name)) {
+                continue;
+            }
+            report(config, measure(config, name, size, [&] { consume(sha1::tree::hash_tree(bytes, threads).root); }));
+        }
+    }
+
+    // Formatting digests for manifests: hex into a caller buffer, and back.
+    void bench_hex(const Config& config, const std::string& input) {
+        const size_t count = config.quick ? 1024 : 65536;
+        std::vector<sha1::Digest> digests(count);
+        for (size_t i = 0; i < count; i++) {
+            std::memcpy(digests[i].data(), input.data() + i * sha1::DIGEST_LEN % (input.size() - sha1::DIGEST_LEN),
+                        sha1::DIGEST_LEN);
+        }
+        std::vector<char> text(count * sha1::HEX_LEN);
+        const std::string encode = "hex_encode/x" + std::to_string(count);
+        if (wanted(config, encode)) {
+            report(config, measure(config, encode, count * sha1::DIGEST_LEN, [&] {
+                for (size_t i = 0; i < count; i++) {
+                    sha1::to_hex(digests[i], std::span<char, sha1::HEX_LEN>(text.data() + i * sha1::HEX_LEN, sha1::HEX_LEN));
+                }
+                consume(static_cast<size_t>(text[0]));
+            }));
+        }
+        const std::string decode = "hex_decode/x" + std::to_string(count);
+        if (wanted(config, decode)) {
+            report(config, measure(config, decode, count * sha1::DIGEST_LEN, [&] {
+                for (size_t i = 0; i < count; i++) {
+                    hex::decode(std::string_view(text.data() + i * sha1::HEX_LEN, sha1::HEX_LEN), digests[i]);
+                }
+                consume(digests[0]);
+            }));
+        }
+    }
+
+    // Content-defined chunking plus a SHA-1 per chunk, at increasing worker counts.
+    void bench_cdc(const Config& config, const std::string& input) {
+        const uint64_t size = std::min<uint64_t>(input.size(), config.quick ? (4 << 20) : (256 << 20));
+        const auto bytes = std::as_bytes(std::span(input.data(), size));
+        const std::string cut_name = "cdc_cut_only/" + size_label(size);
+        if (wanted(config, cut_name)) {
+            const cdc::Params params;
+            report(config, measure(config, cut_name, size, [&] {
+                size_t chunks = 0;
+                for (size_t pos = 0; pos < bytes.size(); chunks++) {
+                    pos += cdc::cut(bytes.subspan(pos), params);
+                }
+                consume(chunks);
+            }));
+        }
+        for (unsigned threads = 1; threads <= std::max(1u, std::thread::hardware_concurrency()); threads *= 2) {
+            const std::string name = "cdc_sha1/threads=" + std::to_string(threads) + "/" + size_label(size);
+            if (!wanted(config, name)) {
+                continue;
+            }
+            report(config, measure(config, name, size, [&] { consume(cdc::chunk(bytes, {}, threads).back().digest); }));
+        }
+    }
+
+    // One-shot SHA-256 under each of its backends, next to the hash_string cases for SHA-1.
+    void bench_sha256(const Config& config, const std::string& input) {
+        const auto original = sha256::active_backend();
+        for (auto backend : {sha256::Backend::Portable, sha256::Backend::ShaNi}) {
+            if (!sha256::set_backend(backend)) {
+                continue;
+            }
+            for (uint64_t size : message_sizes(config)) {
+                const std::string name = "sha256/" + size_label(size);
+                if (!wanted(config, name)) {
+                    continue;
+                }
+                const auto message = std::as_bytes(std::span(input.data(), size));
+                Result r = measure(config, name, size, [&] { consume(sha256::hash(message)); });
+                r.backend = sha256::backend_name(backend);
+                report(config, r);
+            }
+        }
+        sha256::set_backend(original);
+    }
+
+    constexpr uint64_t MAX_INPUT_SIZE = uint64_t{64} << 30;
+
+    void usage(const char* argv0) {
+        std::cerr << "Usage: " << argv0 << " [--json] [--quick] [--max-size BYTES] [--filter SUBSTRING]\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    std::optional<uint64_t> max_size;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--json") {
+            config.json = true;
+        } else if (arg == "--quick") {
+            config.quick = true;
+            config.min_seconds = 0.0;
+        } else if (arg == "--max-size" && i + 1 < argc) {
+            const std::string_view value = argv[++i];
+            uint64_t bytes;
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), bytes);
+            // The whole range is held in memory as one input, so cap it well short of any address space.
+            if (error != std::errc() || end != value.data() + value.size() || bytes > MAX_INPUT_SIZE) {
+                std::cerr << "Error: --max-size takes a byte count up to " << MAX_INPUT_SIZE << ", not '" << value << "'\n";
+                usage(argv[0]);
+                return 1;
+            }
+            max_size = bytes;
+        } else if (arg == "--filter" && i + 1 < argc) {
+            config.filter = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // --quick only shrinks the default, whichever order the options came in.
+    config.max_size = max_size ? *max_size : config.quick ? 1 << 20 : config.max_size;
+
+    const std::string input = make_input(std::max<uint64_t>(config.max_size, 4 << 20));
+    const auto original = sha1::active_backend();
+    for (auto backend : {sha1::Backend::Portable, sha1::Backend::ShaNi}) {
+        if (!sha1::set_backend(backend)) {
+            continue;
+        }
+        bench_one_shot(config, input);
+        bench_streaming(config, input);
+        bench_file(config, input);
+    }
+    sha1::set_backend(original);
+    bench_batch(config, input);
+    bench_hmac(config, input);
+    bench_pbkdf2(config, input);
+    bench_tree(config, input);
+    bench_cdc(config, input);
+    bench_hex(config, input);
+    bench_sha256(config, input);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <hash/sha1.h>
+
+#pragma once
+
+/**
+ * Content-defined chunking with a SHA-1 per chunk, for backups that only store what changed.
+ *
+ * Chunk boundaries depend on the bytes around them and not on their offset, so inserting or
+ * deleting data only moves the boundaries next to the edit and every other chunk keeps its
+ * digest.
+ *
+ * Format version 1 (FastCDC with normalized chunking, level 2):
+ * - A gear hash h = (h << 1) + GEAR[byte] rolls over the chunk, starting from 0 at byte
+ *   `min_size`. Bytes before that can never end a chunk.
+ * - Before `avg_size`, a chunk ends after the byte that leaves the top log2(avg_size) + 2 bits
+ *   of h all zero. From `avg_size` on, the top log2(avg_size) - 2 bits are enough. Chunks
+ *   therefore cluster around `avg_size`.
+ * - A chunk that reaches `max_size` ends there. The last chunk holds whatever is left, and an
+ *   empty input has no chunks.
+ * - GEAR is 256 words of splitmix64 seeded with 0 (see cdc.cpp).
+ * - Each chunk's digest is the plain SHA-1 of its bytes.
+ *
+ * Changing the table, the masks or the cut rule moves every boundary and needs a new VERSION.
+ */
+namespace hash::cdc {
+    constexpr uint32_t VERSION = 1;
+
+    struct Params {
+        size_t min_size = 16 * 1024;
+        size_t avg_size = 64 * 1024; // A power of two
+        size_t max_size = 256 * 1024;
+
+        // Throws std::invalid_argument unless 64 <= min_size <= avg_size <= max_size <= 1 GiB
+        // and avg_size is a power of two of at least 256.
+        void validate() const;
+    };
+
+    struct Chunk {
+        uint64_t offset;
+        uint64_t length;
+        sha1::Digest digest;
+    };
+
+    // Called once per chunk, in input order.
+    using ChunkSink = std::function<void(const Chunk&)>;
+
+    /**
+     * Length of the chunk that starts at `data[0]`. `data` must hold at least `max_size` bytes
+     * or run to the end of the input, otherwise a later byte could still move the boundary.
+     * `params` must be valid.
+     */
+    size_t cut(std::span<const std::byte> data, const Params& params);
+
+    /**
+     * Streaming chunker. Chunks are cut on the calling thread and hashed on `threads` workers
+     * (0 means one per core) while the cutting goes on, straight out of the caller's memory.
+     * Only a chunk that straddles two update() calls is copied.
+     * Chunks are passed to `sink` in order at the end of each update() and in finalize().
+     */
+    class Chunker {
+    public:
+        explicit Chunker(ChunkSink sink, const Params& params = {}, unsigned threads = 0);
+        ~Chunker();
+        Chunker(const Chunker&) = delete;
+        Chunker& operator=(const Chunker&) = delete;
+
+        Chunker& update(std::span<const std::byte> data);
+        // Emits the last chunk. The chunker must not be used afterwards.
+        void finalize();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> impl;
+    };
+
+    std::vector<Chunk> chunk(std::span<const std::byte> data, const Params& params = {}, unsigned threads = 0);
+    void chunk_fd(int fd, const std::string& name, const ChunkSink& sink, const Params& params = {},
+                  unsigned threads = 0);
+    // "-" reads stdin.
+    void chunk_file(const std::string& path, const ChunkSink& sink, const Params& params = {}, unsigned threads = 0);
+}
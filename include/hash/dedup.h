@@ -0,0 +1,53 @@
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <hash/sha1.h>
+
+#pragma once
+
+/**
+ * Duplicate file finder.
+ *
+ * Files are narrowed down in three rounds and each round only sees what the one before could
+ * not tell apart:
+ *   1. size, from the directory walk alone;
+ *   2. SHA-1 of the first and last `edge_bytes` of each file (which is the whole file when it
+ *      is no bigger than two edges, so small files are settled here);
+ *   3. SHA-1 of the whole file.
+ * Rounds 2 and 3 run on a worker pool. Only as many files are open and mapped at once as there
+ * are workers, so memory use does not depend on the size or number of files.
+ */
+namespace hash::dedup {
+    struct Options {
+        unsigned threads = 0;      // 0 means one per core
+        size_t edge_bytes = 4096;  // Bytes read from each end of a file in round 2
+        uint64_t min_size = 1;     // Smaller files are ignored; 1 skips empty files
+    };
+
+    struct Group {
+        uint64_t size;
+        sha1::Digest digest;            // Of the whole file
+        std::vector<std::string> paths; // Sorted
+    };
+
+    struct Report {
+        std::vector<Group> groups; // Largest files first, then by first path
+        uint64_t files = 0;        // Regular files considered
+        uint64_t bytes_total = 0;  // Their combined size
+        uint64_t bytes_read = 0;   // Bytes actually hashed to find the groups
+        std::vector<std::string> errors; // Unreadable files and directories; these are skipped
+
+        // Bytes that would be freed by keeping one file of every group.
+        uint64_t reclaimable() const;
+    };
+
+    /**
+     * Finds files with identical content under `roots` (files or directories, walked
+     * recursively). Symlinks are not followed and hard links to one file count as one file.
+     * The result does not depend on the thread count or on directory listing order.
+     */
+    Report find_duplicates(std::span<const std::string> roots, const Options& opts = {});
+}
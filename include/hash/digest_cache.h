@@ -0,0 +1,119 @@
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include <sys/stat.h>
+
+#include <hash/sha1.h>
+
+#pragma once
+
+namespace hash::sha1 {
+    /**
+     * Identity of one version of a file. If any of these change the cached digest is ignored:
+     * ctime catches writes that put mtime back, inode and device catch files replaced by rename.
+     */
+    struct FileStamp {
+        uint64_t dev;
+        uint64_t ino;
+        uint64_t size;
+        int64_t mtime_ns;
+        int64_t ctime_ns;
+
+        static FileStamp of(const struct stat& st);
+        bool operator==(const FileStamp&) const = default;
+    };
+
+    /**
+     * On-disk index of file digests keyed by FileStamp, so unchanged files are never read again.
+     *
+     * The file is a 64-byte header followed by a power-of-two table of 64-byte records, open
+     * addressed on (dev, inode) with linear probing, and is used through a read-only mmap.
+     * Nothing is ever modified in place: commit() takes an flock on "<path>.lock", merges the
+     * current file with everything store()d since, writes the result to a temporary file and
+     * renames it over the old one. Readers in other processes keep their old snapshot until
+     * they reopen, and never see a half-written table.
+     *
+     * A file whose mtime or ctime is within RACY_WINDOW_NS of the moment it was hashed is not
+     * cached: it could change again without its timestamps moving.
+     *
+     * Entries are never dropped on their own, since the index cannot tell a deleted file from one
+     * that this run simply did not visit. Turn on set_prune() for runs that cover everything the
+     * index is for: commit() then keeps only the entries found or stored since the last commit,
+     * which bounds the index by the size of the tree however much it churns.
+     *
+     * lookup() and store() are safe to call from many threads at once.
+     */
+    class DigestCache {
+    public:
+        static constexpr int64_t RACY_WINDOW_NS = 2'000'000'000;
+
+        struct Stats {
+            uint64_t hits;
+            uint64_t misses;
+        };
+
+        // Opens (or prepares to create) the index at `path`. A missing or unreadable file is an empty cache.
+        explicit DigestCache(std::string path);
+        ~DigestCache();
+        DigestCache(const DigestCache&) = delete;
+        DigestCache& operator=(const DigestCache&) = delete;
+
+        // With refresh on, lookups always miss but fresh digests are still stored.
+        void set_refresh(bool refresh) { this->refresh = refresh; }
+        // Must be called before any lookup() whose entry should survive the next commit().
+        void set_prune(bool prune);
+        // Tests shorten this so they do not have to wait for files to age.
+        void set_racy_window(int64_t ns) { racy_window_ns = ns; }
+
+        std::optional<Digest> lookup(const FileStamp& stamp) const;
+        void store(const FileStamp& stamp, const Digest& digest);
+
+        /**
+         * Digest of the file open on `fd`, from the index if its stamp still matches, otherwise by
+         * reading it and remembering the result for the next commit(). `name` is for errors only.
+         */
+        std::array<uint32_t, 5> hash_fd(int fd, const std::string& name);
+
+        /**
+         * Publishes every store() since the last commit. Must not run alongside lookup() or
+         * store() on the same object. Throws std::runtime_error on I/O failure.
+         */
+        void commit();
+
+        size_t size() const { return count; }
+        Stats stats() const { return {hits.load(), misses.load()}; }
+
+    private:
+        void map();
+        void unmap();
+
+        std::string path;
+        bool refresh = false;
+        int64_t racy_window_ns = RACY_WINDOW_NS;
+
+        const std::byte* data = nullptr;
+        size_t data_len = 0;
+        uint64_t capacity = 0; // Slots in the mapped table
+        uint64_t count = 0;    // Used slots in the mapped table
+
+        bool prune = false;
+        std::unique_ptr<std::atomic<bool>[]> seen; // Per mapped slot: found by lookup(). Only while pruning.
+
+        std::mutex pending_mutex;
+        std::map<std::pair<uint64_t, uint64_t>, std::pair<FileStamp, Digest>> pending; // By (dev, inode)
+
+        mutable std::atomic<uint64_t> hits = 0;
+        mutable std::atomic<uint64_t> misses = 0;
+    };
+
+    // hash_file() that consults `cache` first.
+    std::string hash_file(const std::string& path, DigestCache& cache);
+}
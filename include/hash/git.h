@@ -0,0 +1,64 @@
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <hash/sha1.h>
+
+#pragma once
+
+/**
+ * Git-compatible object IDs (SHA-1 object format).
+ * https://git-scm.com/book/en/v2/Git-Internals-Git-Objects
+ *
+ * An object ID is the SHA-1 of "<type> <size>\0" followed by the object's content.
+ */
+namespace hash::git {
+    using ObjectId = sha1::Digest;
+
+    // Modes git records in a tree. Directories are written without a leading zero.
+    constexpr std::string_view MODE_FILE = "100644";
+    constexpr std::string_view MODE_EXECUTABLE = "100755";
+    constexpr std::string_view MODE_SYMLINK = "120000";
+    constexpr std::string_view MODE_TREE = "40000";
+    constexpr std::string_view MODE_GITLINK = "160000"; // A commit of another repository, e.g. a submodule
+
+    struct TreeEntry {
+        std::string mode;
+        std::string name;
+        ObjectId id;
+    };
+
+    // `git hash-object` of in-memory content.
+    ObjectId blob_id(std::span<const std::byte> content);
+
+    /**
+     * `git hash-object <path>`. The header is built from the file's size and the content is
+     * streamed into the hasher without copying. "-" hashes stdin. Throws std::runtime_error if
+     * the file cannot be read or changes size while it is being hashed.
+     */
+    ObjectId hash_blob_file(const std::string& path);
+
+    /**
+     * ID of a tree object holding `entries`. Entries are sorted the way git sorts them, by name
+     * with directories compared as if their name ended in '/', so any order is accepted.
+     */
+    ObjectId tree_id(std::vector<TreeEntry> entries);
+
+    /**
+     * ID `git write-tree` would print after `git add -A` of every file under `dir`.
+     *
+     * Directories are listed and files hashed in parallel on `threads` workers (0 means one per
+     * core); a directory's tree is built as soon as its last child is done, so subtrees combine
+     * bottom-up while the rest of the walk carries on. Like git, ".git" is skipped, empty
+     * directories are left out, executables get 100755 and symlinks are stored as a blob of
+     * their target. .gitignore is not consulted.
+     *
+     * A subdirectory holding a ".git" (a submodule checkout or any other nested repository) is
+     * not descended into. Like git it becomes a 160000 gitlink entry naming the commit its HEAD
+     * points at, found through loose refs or packed-refs. Throws std::runtime_error if that
+     * HEAD does not resolve, e.g. a repository with no commit yet, which `git add` refuses too.
+     */
+    ObjectId write_tree(const std::string& dir, unsigned threads = 0);
+}
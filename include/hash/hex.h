@@ -0,0 +1,74 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+
+#pragma once
+
+/**
+ * Table-driven hex codec that works in caller buffers and never allocates.
+ *
+ * Encoding copies one precomputed two-character pair per byte. Decoding looks both nibbles up
+ * and ORs their error bits together, so a whole string is checked with one branch at the end.
+ */
+namespace hash::hex {
+    namespace detail {
+        inline constexpr char DIGITS[] = "0123456789abcdef";
+
+        // PAIRS[2 * b], PAIRS[2 * b + 1] spell byte b.
+        inline constexpr std::array<char, 512> PAIRS = [] {
+            std::array<char, 512> pairs{};
+            for (size_t b = 0; b < 256; b++) {
+                pairs[2 * b] = DIGITS[b >> 4];
+                pairs[2 * b + 1] = DIGITS[b & 0xF];
+            }
+            return pairs;
+        }();
+
+        // Nibble value of a hex digit (either case), 0xF0 for anything else.
+        inline constexpr std::array<uint8_t, 256> NIBBLES = [] {
+            std::array<uint8_t, 256> nibbles{};
+            nibbles.fill(0xF0);
+            for (uint8_t i = 0; i < 10; i++) {
+                nibbles['0' + i] = i;
+            }
+            for (uint8_t i = 0; i < 6; i++) {
+                nibbles['a' + i] = static_cast<uint8_t>(10 + i);
+                nibbles['A' + i] = static_cast<uint8_t>(10 + i);
+            }
+            return nibbles;
+        }();
+    }
+
+    /**
+     * Writes 2 * bytes.size() lowercase hex digits to `out` and returns the character after the
+     * last one. `out` must have room for them; nothing is NUL-terminated.
+     */
+    inline char* encode(std::span<const std::byte> bytes, char* out) {
+        for (std::byte b : bytes) {
+            std::memcpy(out, &detail::PAIRS[2 * std::to_integer<size_t>(b)], 2);
+            out += 2;
+        }
+        return out;
+    }
+
+    /**
+     * Parses exactly 2 * out.size() hex digits, in either case, into `out`. Returns false, with
+     * `out` unspecified, on a wrong length or a character that is not a hex digit.
+     */
+    inline bool decode(std::string_view hex, std::span<std::byte> out) {
+        if (hex.size() != 2 * out.size()) {
+            return false;
+        }
+        uint8_t bad = 0;
+        for (size_t i = 0; i < out.size(); i++) {
+            const uint8_t hi = detail::NIBBLES[static_cast<uint8_t>(hex[2 * i])];
+            const uint8_t lo = detail::NIBBLES[static_cast<uint8_t>(hex[2 * i + 1])];
+            bad |= hi | lo;
+            out[i] = static_cast<std::byte>((hi << 4) | (lo & 0xF));
+        }
+        return (bad & 0xF0) == 0;
+    }
+}
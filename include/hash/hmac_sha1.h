@@ -0,0 +1,73 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include <hash/sha1.h>
+
+#pragma once
+
+/**
+ * HMAC-SHA1.
+ * https://datatracker.ietf.org/doc/html/rfc2104
+ *
+ * HMAC(K, m) = SHA-1((K ^ opad) || SHA-1((K ^ ipad) || m)). Both padded keys are exactly one
+ * block long, so a Key compresses them once and keeps the two resulting H vectors. Every
+ * message after that costs its own blocks plus a single outer block, and nothing allocates.
+ */
+namespace hash::hmac_sha1 {
+    using Digest = sha1::Digest;
+
+    // HMAC over one message, fed in pieces like sha1::Hasher.
+    class Mac {
+    public:
+        Mac& update(std::span<const std::byte> data) {
+            sha1::update(inner, data);
+            return *this;
+        }
+
+        Mac& update(std::string_view s) {
+            return update(std::as_bytes(std::span(s.data(), s.size())));
+        }
+
+        Digest finalize();
+
+    private:
+        friend class Key;
+        Mac(const std::array<uint32_t, 5>& inner_midstate, const std::array<uint32_t, 5>& outer_midstate);
+
+        sha1::Sha1_context inner;
+        std::array<uint32_t, 5> outer;
+    };
+
+    class Key {
+    public:
+        // Keys longer than a block are hashed first, as RFC 2104 says.
+        explicit Key(std::span<const std::byte> key);
+        explicit Key(std::string_view key) : Key(std::as_bytes(std::span(key.data(), key.size()))) {}
+
+        Mac begin() const { return Mac(inner, outer); }
+        Digest sign(std::span<const std::byte> message) const { return begin().update(message).finalize(); }
+        // Compares in constant time.
+        bool verify(std::span<const std::byte> message, const Digest& tag) const;
+
+        // H after compressing K ^ ipad and K ^ opad.
+        const std::array<uint32_t, 5>& inner_midstate() const { return inner; }
+        const std::array<uint32_t, 5>& outer_midstate() const { return outer; }
+
+    private:
+        std::array<uint32_t, 5> inner;
+        std::array<uint32_t, 5> outer;
+    };
+
+    // Time depends only on the length, never on where the digests differ.
+    bool equal(std::span<const std::byte> a, std::span<const std::byte> b);
+
+    /**
+     * Checks tags[i] against messages[i] for every i and writes the outcome to ok[i]. Returns
+     * true if every tag matched. Throws std::invalid_argument if the spans differ in size.
+     */
+    bool verify_many(const Key& key, std::span<const std::span<const std::byte>> messages,
+                     std::span<const Digest> tags, std::span<bool> ok);
+}
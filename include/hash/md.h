@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+
+#pragma once
+
+/**
+ * The Merkle–Damgård construction shared by every hash function in boogie.
+ *
+ * A hash function is described by a traits type (see md::Traits): its word type, state size,
+ * block size, byte order, length field, initial value and block function. Buffering the tail
+ * between updates, padding and serialising the digest are written once here, as templates, so
+ * each function gets code specialised for it at compile time and nothing is dispatched virtually.
+ *
+ * Everything here is constexpr. In a constant expression blocks go through Traits::block(), a
+ * straightforward reference kernel; at run time they go through Traits::compress(), which runs
+ * the fastest backend the CPU supports.
+ */
+namespace hash::md {
+    template<typename T>
+    concept Traits = requires(std::array<typename T::Word, T::STATE_WORDS>& H, const std::byte* p, size_t n) {
+        requires std::unsigned_integral<typename T::Word>;
+        requires T::BLOCK_BYTES % sizeof(typename T::Word) == 0;
+        requires T::DIGEST_BYTES <= T::STATE_WORDS * sizeof(typename T::Word);
+        requires T::LENGTH_BYTES == 8 || T::LENGTH_BYTES == 16; // Message length in bits, zero-extended
+        requires T::LENGTH_BYTES < T::BLOCK_BYTES;
+        { T::ENDIAN } -> std::convertible_to<std::endian>;     // Of message words, length and digest
+        { T::IV } -> std::convertible_to<std::array<typename T::Word, T::STATE_WORDS>>;
+        T::block(H, p);       // One block, constexpr
+        T::compress(H, p, n); // `n` consecutive blocks, run time only
+    };
+
+    template<Traits T>
+    using State = std::array<typename T::Word, T::STATE_WORDS>;
+
+    template<Traits T>
+    using Digest = std::array<std::byte, T::DIGEST_BYTES>;
+
+    template<Traits T>
+    struct Context {
+        // Chaining value, the only part of the computation that survives between blocks.
+        State<T> H = T::IV;
+
+        // Tail of the message that did not fill a whole block yet.
+        // Full blocks are compressed straight out of the caller's memory and never land here.
+        std::array<std::byte, T::BLOCK_BYTES> block;
+        size_t block_len = 0;
+
+        uint64_t message_len = 0; // Total number of bytes passed to update()
+    };
+
+    // Reads one word stored in the byte order of T.
+    template<Traits T>
+    constexpr typename T::Word load(const std::byte* p) {
+        using Word = typename T::Word;
+        if !consteval {
+            Word w;
+            std::memcpy(&w, p, sizeof(w));
+            if constexpr (T::ENDIAN != std::endian::native) {
+                w = std::byteswap(w);
+            }
+            return w;
+        }
+        Word w = 0;
+        for (size_t i = 0; i < sizeof(Word); i++) {
+            const size_t shift = T::ENDIAN == std::endian::big ? 8 * (sizeof(Word) - 1 - i) : 8 * i;
+            w |= static_cast<Word>(std::to_integer<Word>(p[i]) << shift);
+        }
+        return w;
+    }
+
+    // Runs `num_blocks` consecutive blocks through the block function.
+    template<Traits T>
+    constexpr void compress(State<T>& H, const std::byte* blocks, size_t num_blocks) {
+        if consteval {
+            for (size_t i = 0; i < num_blocks; i++) {
+                T::block(H, blocks + i * T::BLOCK_BYTES);
+            }
+        } else {
+            T::compress(H, blocks, num_blocks);
+        }
+    }
+
+    // Size of the buffer pad() needs for a tail of `tail_len` bytes.
+    template<Traits T>
+    constexpr size_t padded_len(size_t tail_len) {
+        constexpr size_t min_pad = 1 + T::LENGTH_BYTES; // 1 for 0x80, then the length
+        return ((tail_len + min_pad + T::BLOCK_BYTES - 1) / T::BLOCK_BYTES) * T::BLOCK_BYTES;
+    }
+
+    /**
+     * Pads the message so its length is a whole number of blocks: a '1' bit (0x80), '0's up to
+     * LENGTH_BYTES short of a block boundary, then the message length in bits.
+     *
+     * `buf` holds the last `tail_len` bytes of the message and must have room for
+     * padded_len(tail_len) bytes. `prefix_len` is the number of bytes that came before them.
+     * Returns the size of the padded buffer.
+     */
+    template<Traits T>
+    constexpr size_t pad(std::span<std::byte> buf, size_t tail_len, uint64_t prefix_len) {
+        const size_t len = padded_len<T>(tail_len);
+        assert(buf.size() >= len);
+
+        buf[tail_len] = std::byte{0x80};
+        const auto length_field = buf.begin() + static_cast<ptrdiff_t>(len - T::LENGTH_BYTES);
+        std::fill(buf.begin() + static_cast<ptrdiff_t>(tail_len) + 1, length_field, std::byte{0});
+
+        const uint64_t bit_len = (prefix_len + tail_len) * 8;
+        for (size_t i = 0; i < T::LENGTH_BYTES; i++) {
+            const size_t shift = T::ENDIAN == std::endian::big ? 8 * (T::LENGTH_BYTES - 1 - i) : 8 * i;
+            length_field[static_cast<ptrdiff_t>(i)] = shift < 64 ? static_cast<std::byte>(bit_len >> shift) : std::byte{0};
+        }
+        return len;
+    }
+
+    template<Traits T>
+    constexpr void update(Context<T>& ctx, std::span<const std::byte> data) {
+        ctx.message_len += data.size();
+
+        // Top up a partially filled block first.
+        if (ctx.block_len > 0) {
+            size_t take = std::min(T::BLOCK_BYTES - ctx.block_len, data.size());
+            std::copy_n(data.data(), take, ctx.block.data() + ctx.block_len);
+            ctx.block_len += take;
+            data = data.subspan(take);
+            if (ctx.block_len < T::BLOCK_BYTES) {
+                return;
+            }
+            md::compress<T>(ctx.H, ctx.block.data(), 1);
+            ctx.block_len = 0;
+        }
+
+        // Whole blocks are read in place.
+        size_t num_blocks = data.size() / T::BLOCK_BYTES;
+        md::compress<T>(ctx.H, data.data(), num_blocks);
+        data = data.subspan(num_blocks * T::BLOCK_BYTES);
+
+        // Hold on to the rest until the next update() or finalize().
+        std::copy(data.begin(), data.end(), ctx.block.data());
+        ctx.block_len = data.size();
+    }
+
+    template<Traits T>
+    constexpr State<T> finalize(Context<T>& ctx) {
+        // The padding can spill the tail into a second block.
+        std::array<std::byte, 2 * T::BLOCK_BYTES> tail;
+        std::copy_n(ctx.block.data(), ctx.block_len, tail.data());
+        size_t tail_len = md::pad<T>(tail, ctx.block_len, ctx.message_len - ctx.block_len);
+        md::compress<T>(ctx.H, tail.data(), tail_len / T::BLOCK_BYTES);
+        ctx.block_len = 0;
+        return ctx.H;
+    }
+
+    // The first DIGEST_BYTES bytes of the state, each word in the byte order of T.
+    template<Traits T>
+    constexpr Digest<T> to_digest(const State<T>& H) {
+        using Word = typename T::Word;
+        Digest<T> digest;
+        for (size_t i = 0; i < T::DIGEST_BYTES; i++) {
+            const size_t j = i % sizeof(Word);
+            const size_t shift = T::ENDIAN == std::endian::big ? 8 * (sizeof(Word) - 1 - j) : 8 * j;
+            digest[i] = static_cast<std::byte>(H[i / sizeof(Word)] >> shift);
+        }
+        return digest;
+    }
+
+    /**
+     * Digest of `s`, computed at compile time when used in a constant expression:
+     *   static_assert(md::digest<sha256::Traits>("abc") == ...);
+     * Run time callers want the one-shot hash() of the algorithm instead, which counts stats.
+     */
+    template<Traits T>
+    constexpr Digest<T> digest(std::string_view s) {
+        Context<T> ctx;
+        // Bytes cannot be reinterpreted from chars in a constant expression, so copy a block at a time.
+        std::array<std::byte, T::BLOCK_BYTES> buf{};
+        ctx.block = buf;
+        while (!s.empty()) {
+            const size_t n = std::min(s.size(), buf.size());
+            for (size_t i = 0; i < n; i++) {
+                buf[i] = static_cast<std::byte>(s[i]);
+            }
+            md::update<T>(ctx, std::span<const std::byte>(buf.data(), n));
+            s.remove_prefix(n);
+        }
+        return md::to_digest<T>(md::finalize<T>(ctx));
+    }
+}
@@ -0,0 +1,39 @@
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <hash/hmac_sha1.h>
+
+#pragma once
+
+/**
+ * PBKDF2 with HMAC-SHA1 as the PRF.
+ * https://datatracker.ietf.org/doc/html/rfc8018#section-5.2
+ *
+ * Output block i is U_1 ^ U_2 ^ ... ^ U_c, where U_1 = HMAC(P, S || INT(i)) and
+ * U_j = HMAC(P, U_j-1). After U_1 every HMAC input is exactly one 20-byte digest, so the
+ * padded block is built once and each iteration is two calls of the compression function on
+ * the key's cached midstates: no padding, no byte strings, no allocation.
+ *
+ * Output blocks, and the keys of different requests, do not depend on each other. They are
+ * spread over worker threads and, when hash_many() would use AVX2 or AVX-512, run side by
+ * side on its SIMD lanes.
+ */
+namespace hash::pbkdf2_sha1 {
+    struct Request {
+        std::span<const std::byte> password;
+        std::span<const std::byte> salt;
+        std::span<std::byte> out; // Fills all of it
+    };
+
+    /**
+     * Derives out.size() bytes. `threads` workers share the output blocks (0 means one per core);
+     * work that fits in a single group of SIMD lanes stays on the calling thread.
+     * Throws std::invalid_argument if `iterations` is 0 or the key is longer than RFC 8018 allows.
+     */
+    void derive(std::span<const std::byte> password, std::span<const std::byte> salt, uint32_t iterations,
+                std::span<std::byte> out, unsigned threads = 0);
+
+    // Same as derive() for every request, all with the same iteration count.
+    void derive_many(std::span<const Request> requests, uint32_t iterations, unsigned threads = 0);
+}
@@ -1,6 +1,15 @@
-#include <sstream>
-#include <vector>
-#include <iomanip>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <hash/hex.h>
+#include <hash/md.h>
 
 #pragma once
 
@@ -11,6 +20,10 @@ namespace hash::sha1 {
     constexpr size_t CHUNK_SIZE = 1024;
     constexpr int SHA1_WORD_LEN = 32;
     constexpr int SHA1_BLOCK_LEN = 512;
+    constexpr size_t SHA1_BLOCK_BYTES = SHA1_BLOCK_LEN / 8;
+    constexpr size_t DIGEST_LEN = 20;
+
+    static_assert(CHUNK_SIZE % SHA1_BLOCK_BYTES == 0, "CHUNK_SIZE should be a whole number of blocks");
 
     // These constants are part of the standard
     // https://datatracker.ietf.org/doc/html/rfc3174#section-5
@@ -19,68 +32,263 @@ namespace hash::sha1 {
     constexpr int K_3 = 0x8F1BBCDC;
     constexpr int K_4 = 0xCA62C1D6;
 
-    struct Sha1_context {
+    // The 160-bit message digest as raw bytes, H0 first and big-endian like the hex form.
+    using Digest = std::array<std::byte, DIGEST_LEN>;
+    constexpr size_t HEX_LEN = 2 * DIGEST_LEN;
+
+    void compress(std::array<uint32_t, 5>& H, const std::byte* blocks, size_t num_blocks);
+
+    // SHA-1 as an instance of the Merkle–Damgård engine in hash/md.h.
+    struct Traits {
+        using Word = uint32_t;
+        static constexpr size_t STATE_WORDS = 5;
+        static constexpr size_t BLOCK_BYTES = SHA1_BLOCK_BYTES;
+        static constexpr size_t DIGEST_BYTES = DIGEST_LEN;
+        static constexpr size_t LENGTH_BYTES = 8;
+        static constexpr std::endian ENDIAN = std::endian::big;
+
         /**
          *    The message digest is computed using the message padded as described
          *    in section 4.  The computation is described using two buffers, each
          *    consisting of five 32-bit words, and a sequence of eighty 32-bit
          *    words.  The words of the first 5-word buffer are labeled A,B,C,D,E.
          *    The words of the second 5-word buffer are labeled H0, H1, H2, H3, H4.
-         *    The words of the 80-word sequence are labeled W(0), W(1),..., W(79).
-         *    A single word buffer TEMP is also employed.
+         *
+         *    Only the H buffer survives between blocks, so it is the only part of the
+         *    computation kept in the context. A,B,C,D,E and W live on the stack of compress().
          */
-        std::array<uint32_t, 5> b1 = {0x0,0x0,0x0,0x0,0x0};
-        std::array<uint32_t, 5> H = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
-        std::array<uint32_t, 80> w;
-        uint32_t temp;
+        static constexpr std::array<uint32_t, 5> IV = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+        // RFC 3174 section 6.1 exactly as written. Only used for compile-time digests.
+        static constexpr void block(std::array<uint32_t, 5>& H, const std::byte* block) {
+            uint32_t W[80];
+            for (int t = 0; t < 16; t++) {
+                W[t] = md::load<Traits>(block + 4 * t);
+            }
+            for (int t = 16; t < 80; t++) {
+                W[t] = std::rotl(W[t - 3] ^ W[t - 8] ^ W[t - 14] ^ W[t - 16], 1);
+            }
+            uint32_t A = H[0], B = H[1], C = H[2], D = H[3], E = H[4];
+            for (int t = 0; t < 80; t++) {
+                uint32_t f, K;
+                if (t <= 19) {
+                    f = (B & C) | (~B & D);
+                    K = static_cast<uint32_t>(K_1);
+                } else if (t <= 39) {
+                    f = B ^ C ^ D;
+                    K = static_cast<uint32_t>(K_2);
+                } else if (t <= 59) {
+                    f = (B & C) | (B & D) | (C & D);
+                    K = static_cast<uint32_t>(K_3);
+                } else {
+                    f = B ^ C ^ D;
+                    K = static_cast<uint32_t>(K_4);
+                }
+                const uint32_t temp = std::rotl(A, 5) + f + E + W[t] + K;
+                E = D;
+                D = C;
+                C = std::rotl(B, 30);
+                B = A;
+                A = temp;
+            }
+            H[0] += A;
+            H[1] += B;
+            H[2] += C;
+            H[3] += D;
+            H[4] += E;
+        }
+
+        // At run time blocks go through whichever backend is active.
+        static void compress(std::array<uint32_t, 5>& H, const std::byte* blocks, size_t num_blocks) {
+            sha1::compress(H, blocks, num_blocks);
+        }
+    };
+
+    using Sha1_context = md::Context<Traits>;
+
+    // Implementations of the compression function. compress() runs whichever one is active.
+    enum class Backend {
+        Portable, // Plain C++, available everywhere
+        ShaNi,    // x86 SHA extensions
+    };
+
+    /**
+     * The best supported backend is picked on first use. Setting BOOGIE_SHA1_BACKEND to a
+     * backend_name() overrides that choice for the whole process.
+     */
+    Backend active_backend();
+    bool backend_supported(Backend b);
+    // Returns false (and changes nothing) if the CPU cannot run `b`.
+    bool set_backend(Backend b);
+    std::string_view backend_name(Backend b);
 
-        std::shared_ptr<std::vector<uint32_t>> m; // Message digest buffer. Split into 16 word (512 bits) blocks
-        uint64_t message_len;
+    // Kernels behind hash_many(). The SIMD ones hash 8 or 16 messages side by side.
+    enum class BatchBackend {
+        Scalar, // One message at a time through compress()
+        Avx2,   // 8 lanes
+        Avx512, // 16 lanes
     };
+
+    BatchBackend active_batch_backend();
+    bool backend_supported(BatchBackend b);
+    bool set_backend(BatchBackend b);
+    std::string_view backend_name(BatchBackend b);
+
+    /**
+     * Serialised Sha1_context, the same on every platform (format version 1):
+     *   "BSH1" | version:u8 | tail_len:u8 | 0:u16 | H0..H4:u32 | message_len:u64 | tail
+     * Integers are big-endian and `tail` is the tail_len buffered bytes, so a state is
+     * STATE_HEADER_BYTES + (message_len % 64) bytes long.
+     */
+    constexpr uint8_t STATE_VERSION = 1;
+    constexpr size_t STATE_HEADER_BYTES = 4 + 4 + 5 * 4 + 8;
+    constexpr size_t STATE_MAX_BYTES = STATE_HEADER_BYTES + SHA1_BLOCK_BYTES - 1;
+
+    // Writes the state of `ctx` to `out` and returns its length. Throws std::invalid_argument if `out` is too small.
+    size_t export_state(const Sha1_context& ctx, std::span<std::byte> out);
+    // Throws std::invalid_argument unless `state` is exactly one well-formed exported state.
+    Sha1_context import_state(std::span<const std::byte> state);
+
     Sha1_context makeContext();
+    void update(Sha1_context& ctx, std::span<const std::byte> data);
+    std::array<uint32_t, 5> finalize(Sha1_context& ctx);
+    size_t sha1_pad(std::span<std::byte> buf, size_t message_end_pos, uint64_t message_len);
     std::string hash_string(const std::string& s);
+    // One-shot SHA-1 of a message already in memory. Never allocates.
+    Digest hash(std::span<const std::byte> data);
+
+    // Also works in constant expressions, e.g. constexpr Digest EMPTY = hash("");
+    constexpr Digest hash(std::string_view s) {
+        if consteval {
+            return md::digest<Traits>(s);
+        }
+        return hash(std::as_bytes(std::span(s.data(), s.size())));
+    }
+
+    // Regular files are memory-mapped, anything else is read() in large chunks. See utils::read_all.
     std::string hash_file(const std::string& path);
-    uint sha1_pad(std::vector<char>& buf, uint64_t message_end_pos, uint64_t message_len);
-    std::shared_ptr<std::vector<uint32_t>> toMessageDigestBuffer(const std::vector<char>& padded_message, uint64_t padded_buffer_size);
-    void process(Sha1_context& ctx, std::vector<char> data, size_t buffer_size, bool is_last_chunk);
+    // Hashes whatever is left to read from `fd` (a pipe, a socket, stdin...) in constant memory.
+    std::string hash_fd(int fd);
+    std::array<uint32_t, 5> hash_fd_raw(int fd, const std::string& name);
+
+    // Outcome of hashing one file with hash_files(). `error` is empty on success.
+    struct FileResult {
+        std::array<uint32_t, 5> raw_hash;
+        std::string error;
+
+        bool ok() const { return error.empty(); }
+    };
+
+    class DigestCache;
+
+    /**
+     * Hashes many files concurrently on `threads` workers (0 means one per core).
+     * Files are started largest first so one big file does not end up alone at the tail,
+     * and idle workers steal queued files from busy ones.
+     * `on_result(index, result)` is called on the calling thread in input order, each one
+     * as soon as that file and every file before it are done. A path of "-" reads stdin.
+     * With a `cache`, files whose stamp it already knows are not read at all; the caller
+     * decides when to commit() what was learned.
+     */
+    void hash_files(std::span<const std::string> paths, unsigned threads,
+                    const std::function<void(size_t, const FileResult&)>& on_result,
+                    DigestCache* cache = nullptr);
+
+    /**
+     * Hashes every message in `messages` and writes its digest to the same index of `out`.
+     * Meant for large numbers of short messages: independent messages are interleaved
+     * across SIMD lanes, and a lane picks up the next message as soon as its current one
+     * is done, so mixed lengths keep every lane busy. Does not allocate.
+     * Throws std::invalid_argument if the spans differ in size.
+     */
+    void hash_many(std::span<const std::span<const std::byte>> messages, std::span<Digest> out);
+
+    // Size of the buffer sha1_pad() needs for a tail of `message_end_pos` bytes.
+    constexpr size_t padded_len(size_t message_end_pos) {
+        return md::padded_len<Traits>(message_end_pos);
+    }
+
+    /**
+     * Incremental hasher. Feed it any number of update() calls with arbitrary split
+     * points and call finalize() once at the end. Never allocates.
+     *
+     * A Hasher is a plain value: hash a shared prefix once and copy the Hasher to fork it for
+     * each suffix. export_state()/from_state() carry it across processes and machines.
+     */
+    class Hasher {
+    public:
+        Hasher() : ctx(makeContext()) {}
+        explicit Hasher(const Sha1_context& ctx) : ctx(ctx) {}
+
+        static Hasher from_state(std::span<const std::byte> state) {
+            return Hasher(import_state(state));
+        }
+
+        size_t export_state(std::span<std::byte> out) const {
+            return sha1::export_state(ctx, out);
+        }
+
+        Hasher& update(std::span<const std::byte> data) {
+            sha1::update(ctx, data);
+            return *this;
+        }
+
+        Hasher& update(std::string_view s) {
+            return update(std::as_bytes(std::span(s.data(), s.size())));
+        }
+
+        std::array<uint32_t, 5> finalize() {
+            return sha1::finalize(ctx);
+        }
+
+        const Sha1_context& context() const { return ctx; }
+
+    private:
+        Sha1_context ctx;
+    };
+
+    static constexpr Digest to_digest(const std::array<uint32_t, 5>& raw_hash) {
+        return md::to_digest<Traits>(raw_hash);
+    }
+
+    // Writes the HEX_LEN lowercase hex digits of `digest` to `out`, without allocating.
+    static inline void to_hex(const Digest& digest, std::span<char, HEX_LEN> out) {
+        hex::encode(digest, out.data());
+    }
+
+    static inline std::string to_hex(const Digest& digest) {
+        std::string out(HEX_LEN, '\0');
+        to_hex(digest, std::span<char, HEX_LEN>(out.data(), HEX_LEN));
+        return out;
+    }
 
     static inline std::string to_hex(const std::array<uint32_t, 5>& raw_hash) {
-        const uint32_t* data(raw_hash.data());
-        std::stringstream ss;
-        ss << std::hex << std::setfill('0'); // Set output to hexadecimal and pad with 0
-
-        for (size_t i = 0; i < raw_hash.size(); ++i) {
-            uint32_t val = data[i];
-            // Each uint32_t is 8 hex characters (4 bytes * 2 hex chars/byte)
-            ss << std::setw(8) << val;
+        return to_hex(to_digest(raw_hash));
+    }
+
+    // Parses HEX_LEN hex digits in either case. Empty on anything else.
+    static inline std::optional<Digest> from_hex(std::string_view hex) {
+        Digest digest;
+        if (!hex::decode(hex, digest)) {
+            return std::nullopt;
         }
-        return ss.str();
+        return digest;
     }
 
     template<typename InputStream>
     static std::array<uint32_t, 5> hash_stream_raw(InputStream& is) {
         auto ctx = sha1::makeContext();
-
-        if (is.peek() == EOF) { // is.read() will fail for empty input streams
-            std::vector<char> empty_buffer;
-            process(ctx, empty_buffer, is.gcount(), true);
-            return ctx.H;
-        }
-
-        std::vector<char> buffer(CHUNK_SIZE);
-        while(is.read(buffer.data(), buffer.size())) { // Read in 4096 byte sized chunks from stream
-            process(ctx, buffer, is.gcount(), false);
-        }
+        std::array<char, CHUNK_SIZE> buffer;
 
         /**
-         * InputSteam::read(data, size) attempts to read size bytes. 
-         * InputSteam::gcount returns the number of bytes left.
-         * Let's read the rest of the stream left over from the read operations.
+         * InputSteam::read(data, size) attempts to read size bytes and fails on a short read.
+         * InputSteam::gcount still reports the bytes the short read produced, so keep
+         * going until a read comes back empty.
          */
-        if(is.gcount() > 0) { 
-            process(ctx, buffer, is.gcount(), true);
+        while (is.read(buffer.data(), buffer.size()) || is.gcount() > 0) {
+            update(ctx, std::as_bytes(std::span(buffer.data(), static_cast<size_t>(is.gcount()))));
         }
-        return ctx.H;
+        return finalize(ctx);
     }
 
     template<typename InputStream>
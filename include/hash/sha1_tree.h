@@ -0,0 +1,92 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <hash/sha1.h>
+
+#pragma once
+
+/**
+ * sha1-tree: a Merkle tree over SHA-1, so one large input can be hashed on every core.
+ *
+ * Format version 1 ("sha1-tree-v1"):
+ * - The input is cut into leaves of exactly LEAF_SIZE bytes; the last leaf holds whatever is
+ *   left. An empty input is a single empty leaf.
+ * - Leaf digest: SHA-1(0x00 || leaf bytes). Node digest: SHA-1(0x01 || left || right).
+ * - Leaves are combined pairwise, level by level, and an unpaired node at the end of a level
+ *   moves up unchanged. This is the same shape as RFC 6962 (Certificate Transparency).
+ * - The root is the sha1-tree digest. It is NOT the SHA-1 of the input.
+ *
+ * The prefixes keep a leaf from ever being passed off as a node and vice versa. Changing the
+ * leaf size or either prefix changes every digest and needs a new VERSION.
+ */
+namespace hash::sha1::tree {
+    constexpr uint32_t VERSION = 1;
+    constexpr size_t LEAF_SIZE = 1024 * 1024;
+    constexpr std::byte LEAF_PREFIX{0x00};
+    constexpr std::byte NODE_PREFIX{0x01};
+
+    static_assert(LEAF_SIZE % SHA1_BLOCK_BYTES == 0, "LEAF_SIZE should be a whole number of blocks");
+
+    struct Tree {
+        Digest root;
+        // leaves[i] covers bytes [i * LEAF_SIZE, (i + 1) * LEAF_SIZE) of the input.
+        std::vector<Digest> leaves;
+    };
+
+    Digest leaf_digest(std::span<const std::byte> leaf);
+    Digest node_digest(const Digest& left, const Digest& right);
+    // Root over leaf digests. Throws std::invalid_argument on an empty span.
+    Digest root_of(std::span<const Digest> leaves);
+
+    /**
+     * True if `data`, found at byte `offset` of the original input, matches the leaf digests of
+     * a Tree whose root was trusted. `offset` must be a multiple of LEAF_SIZE and `data` must end
+     * on a leaf boundary or at the end of the input.
+     */
+    bool verify_range(std::span<const std::byte> data, uint64_t offset, std::span<const Digest> leaves);
+
+    /**
+     * Incremental tree hasher. Whole leaves are hashed straight out of the caller's memory on
+     * `threads` workers (0 means one per core); a partial leaf is buffered until it fills up.
+     * Input that arrives in small pieces is gathered into batches of one leaf per worker first.
+     */
+    class TreeHasher {
+    public:
+        explicit TreeHasher(unsigned threads = 0);
+        ~TreeHasher();
+        TreeHasher(const TreeHasher&) = delete;
+        TreeHasher& operator=(const TreeHasher&) = delete;
+
+        TreeHasher& update(std::span<const std::byte> data);
+        Tree finalize();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> impl;
+    };
+
+    Tree hash_tree(std::span<const std::byte> data, unsigned threads = 0);
+    Tree hash_fd_tree(int fd, const std::string& name, unsigned threads = 0);
+    // "-" reads stdin.
+    Tree hash_file_tree(const std::string& path, unsigned threads = 0);
+    std::string hash_file(const std::string& path, unsigned threads = 0);
+
+    template<typename InputStream>
+    static Tree hash_stream_tree(InputStream& is, unsigned threads = 0) {
+        TreeHasher hasher(threads);
+        std::vector<char> buffer(LEAF_SIZE);
+        while (is.read(buffer.data(), buffer.size()) || is.gcount() > 0) {
+            hasher.update(std::as_bytes(std::span(buffer.data(), static_cast<size_t>(is.gcount()))));
+        }
+        return hasher.finalize();
+    }
+
+    template<typename InputStream>
+    static std::string hash_stream(InputStream& is, unsigned threads = 0) {
+        return to_hex(hash_stream_tree(is, threads).root);
+    }
+}
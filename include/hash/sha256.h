@@ -0,0 +1,186 @@
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <hash/hex.h>
+#include <hash/md.h>
+
+#pragma once
+
+// SHA-256, FIPS 180-4 section 6.2, on the Merkle–Damgård engine in hash/md.h.
+namespace hash::sha256 {
+    constexpr size_t BLOCK_BYTES = 64;
+    constexpr size_t DIGEST_LEN = 32;
+    constexpr size_t HEX_LEN = 2 * DIGEST_LEN;
+
+    // The 256-bit message digest as raw bytes, H0 first and big-endian like the hex form.
+    using Digest = std::array<std::byte, DIGEST_LEN>;
+
+    // K(0)..K(63) from FIPS 180-4 section 4.2.2: the first 32 bits of the fractional parts of the
+    // cube roots of the first 64 primes.
+    constexpr std::array<uint32_t, 64> K = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+
+    void compress(std::array<uint32_t, 8>& H, const std::byte* blocks, size_t num_blocks);
+
+    struct Traits {
+        using Word = uint32_t;
+        static constexpr size_t STATE_WORDS = 8;
+        static constexpr size_t BLOCK_BYTES = sha256::BLOCK_BYTES;
+        static constexpr size_t DIGEST_BYTES = DIGEST_LEN;
+        static constexpr size_t LENGTH_BYTES = 8;
+        static constexpr std::endian ENDIAN = std::endian::big;
+
+        // H(0) from section 5.3.3: the fractional parts of the square roots of the first 8 primes.
+        static constexpr std::array<uint32_t, 8> IV = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                                       0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+        /**
+         * Section 6.2.2 as written: build the 64-word schedule, run 64 rounds, add the working
+         * variables back into H. This is the portable backend as well as the compile-time one.
+         */
+        static constexpr void block(std::array<uint32_t, 8>& H, const std::byte* block) {
+            uint32_t W[64];
+            for (int t = 0; t < 16; t++) {
+                W[t] = md::load<Traits>(block + 4 * t);
+            }
+            for (int t = 16; t < 64; t++) {
+                const uint32_t s0 = std::rotr(W[t - 15], 7) ^ std::rotr(W[t - 15], 18) ^ (W[t - 15] >> 3);
+                const uint32_t s1 = std::rotr(W[t - 2], 17) ^ std::rotr(W[t - 2], 19) ^ (W[t - 2] >> 10);
+                W[t] = s1 + W[t - 7] + s0 + W[t - 16];
+            }
+
+            uint32_t a = H[0], b = H[1], c = H[2], d = H[3], e = H[4], f = H[5], g = H[6], h = H[7];
+            for (int t = 0; t < 64; t++) {
+                const uint32_t S1 = std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25);
+                const uint32_t ch = (e & f) ^ (~e & g);
+                const uint32_t T1 = h + S1 + ch + K[t] + W[t];
+                const uint32_t S0 = std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22);
+                const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+                const uint32_t T2 = S0 + maj;
+                h = g;
+                g = f;
+                f = e;
+                e = d + T1;
+                d = c;
+                c = b;
+                b = a;
+                a = T1 + T2;
+            }
+            H[0] += a;
+            H[1] += b;
+            H[2] += c;
+            H[3] += d;
+            H[4] += e;
+            H[5] += f;
+            H[6] += g;
+            H[7] += h;
+        }
+
+        // At run time blocks go through whichever backend is active.
+        static void compress(std::array<uint32_t, 8>& H, const std::byte* blocks, size_t num_blocks) {
+            sha256::compress(H, blocks, num_blocks);
+        }
+    };
+
+    using Sha256_context = md::Context<Traits>;
+
+    // Implementations of the compression function. compress() runs whichever one is active.
+    enum class Backend {
+        Portable, // Plain C++, available everywhere
+        ShaNi,    // x86 SHA extensions
+    };
+
+    /**
+     * The best supported backend is picked on first use. Setting BOOGIE_SHA256_BACKEND to a
+     * backend_name() overrides that choice for the whole process.
+     */
+    Backend active_backend();
+    bool backend_supported(Backend b);
+    // Returns false (and changes nothing) if the CPU cannot run `b`.
+    bool set_backend(Backend b);
+    std::string_view backend_name(Backend b);
+
+    void update(Sha256_context& ctx, std::span<const std::byte> data);
+    Digest finalize(Sha256_context& ctx);
+
+    std::string hash_string(const std::string& s);
+    // One-shot SHA-256 of a message already in memory. Never allocates.
+    Digest hash(std::span<const std::byte> data);
+
+    // Also works in constant expressions, e.g. constexpr Digest EMPTY = hash("");
+    constexpr Digest hash(std::string_view s) {
+        if consteval {
+            return md::digest<Traits>(s);
+        }
+        return hash(std::as_bytes(std::span(s.data(), s.size())));
+    }
+
+    // Reads through utils::read_all like sha1::hash_file, so the same read methods apply.
+    std::string hash_file(const std::string& path);
+    // Hashes whatever is left to read from `fd` (a pipe, a socket, stdin...) in constant memory.
+    std::string hash_fd(int fd);
+    Digest hash_fd_raw(int fd, const std::string& name);
+
+    /**
+     * Incremental hasher. Feed it any number of update() calls with arbitrary split
+     * points and call finalize() once at the end. Never allocates.
+     * A Hasher is a plain value: copy it to fork a shared prefix.
+     */
+    class Hasher {
+    public:
+        Hasher() = default;
+        explicit Hasher(const Sha256_context& ctx) : ctx(ctx) {}
+
+        Hasher& update(std::span<const std::byte> data) {
+            sha256::update(ctx, data);
+            return *this;
+        }
+
+        Hasher& update(std::string_view s) {
+            return update(std::as_bytes(std::span(s.data(), s.size())));
+        }
+
+        Digest finalize() {
+            return sha256::finalize(ctx);
+        }
+
+        const Sha256_context& context() const { return ctx; }
+
+    private:
+        Sha256_context ctx;
+    };
+
+    // Writes the HEX_LEN lowercase hex digits of `digest` to `out`, without allocating.
+    static inline void to_hex(const Digest& digest, std::span<char, HEX_LEN> out) {
+        hex::encode(digest, out.data());
+    }
+
+    static inline std::string to_hex(const Digest& digest) {
+        std::string out(HEX_LEN, '\0');
+        to_hex(digest, std::span<char, HEX_LEN>(out.data(), HEX_LEN));
+        return out;
+    }
+
+    // Parses HEX_LEN hex digits in either case. Empty on anything else.
+    static inline std::optional<Digest> from_hex(std::string_view hex) {
+        Digest digest;
+        if (!hex::decode(hex, digest)) {
+            return std::nullopt;
+        }
+        return digest;
+    }
+}
@@ -0,0 +1,55 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#pragma once
+
+/**
+ * Hot-path counters for boogielib.
+ *
+ * Every thread counts into its own slots and snapshot() adds them up on demand, so counting
+ * costs a thread-local add and never a shared cache line. Building with -DBOOGIE_STATS=OFF
+ * compiles every counting site away; snapshot() then returns zeros and ENABLED is false.
+ */
+namespace hash::stats {
+#ifdef BOOGIE_STATS
+    constexpr bool ENABLED = true;
+#else
+    constexpr bool ENABLED = false;
+#endif
+
+    enum class Counter : size_t {
+        BytesHashed,     // Bytes passed to sha1::update() and sha256::update()
+        BlocksPortable,  // 64-byte blocks through each compression kernel, SHA-1 and SHA-256 alike
+        BlocksShaNi,
+        BlocksAvx2,      // Counted per busy lane
+        BlocksAvx512,
+        Chunks,          // Buffers handed out by the file reader (mapped windows or read() calls)
+        ReadNanos,       // Time spent in read(), mmap() and friends
+        ComputeNanos,    // Time spent hashing what was read, page faults on mapped files included
+        Count,
+    };
+
+    struct Snapshot {
+        std::array<uint64_t, static_cast<size_t>(Counter::Count)> values{};
+        uint64_t allocations = 0; // Only counted in programs that report them, like the boogie CLI
+
+        uint64_t operator[](Counter c) const { return values[static_cast<size_t>(c)]; }
+        uint64_t blocks() const;
+    };
+
+    // Totals of every thread, live or finished, since start-up or the last reset().
+    Snapshot snapshot();
+    void reset();
+
+    /**
+     * One JSON object, on one line. The block counts are not split by algorithm, so next to them it
+     * names the backend each algorithm is using: sha1_backend, sha1_batch_backend and sha256_backend.
+     */
+    std::string to_json(const Snapshot& s);
+
+    // For a program's own operator new. The library never allocates through this.
+    void note_allocation();
+}
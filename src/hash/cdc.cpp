@@ -0,0 +1,196 @@
+#include <array>
+#include <bit>
+#include <deque>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include <util/file.h>
+#include <util/thread_pool.h>
+
+#include <hash/cdc.h>
+
+namespace hash::cdc {
+    namespace {
+        constexpr size_t MIN_SIZE_FLOOR = 64;                 // The gear hash only sees the last 64 bytes
+        constexpr size_t AVG_SIZE_FLOOR = 256;                // Keeps log2(avg_size) - 2 bits meaningful
+        constexpr size_t MAX_SIZE_CEILING = size_t{1} << 30;
+
+        // splitmix64 from a zero seed. Part of the format: see cdc.h.
+        constexpr std::array<uint64_t, 256> make_gear() {
+            std::array<uint64_t, 256> table{};
+            uint64_t x = 0;
+            for (auto& entry : table) {
+                x += 0x9E3779B97F4A7C15ULL;
+                uint64_t z = x;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                entry = z ^ (z >> 31);
+            }
+            return table;
+        }
+
+        constexpr std::array<uint64_t, 256> GEAR = make_gear();
+
+        // The top `bits` bits of the hash; the low bits only depend on the last few bytes.
+        constexpr uint64_t top_bits(unsigned bits) {
+            return ~uint64_t{0} << (64 - bits);
+        }
+
+        const Params& checked(const Params& params) {
+            params.validate();
+            return params;
+        }
+    }
+
+    void Params::validate() const {
+        if (min_size < MIN_SIZE_FLOOR || min_size > avg_size || avg_size > max_size || max_size > MAX_SIZE_CEILING) {
+            throw std::invalid_argument("cdc: chunk sizes must satisfy 64 <= min <= avg <= max <= 1 GiB, got "
+                                        + std::to_string(min_size) + "/" + std::to_string(avg_size) + "/"
+                                        + std::to_string(max_size));
+        }
+        if (avg_size < AVG_SIZE_FLOOR || !std::has_single_bit(avg_size)) {
+            throw std::invalid_argument("cdc: average chunk size must be a power of two of at least 256, got "
+                                        + std::to_string(avg_size));
+        }
+    }
+
+    size_t cut(std::span<const std::byte> data, const Params& params) {
+        const size_t n = data.size();
+        if (n <= params.min_size) {
+            return n;
+        }
+        const size_t end = std::min(n, params.max_size);
+        const size_t normal = std::min(end, params.avg_size);
+        const unsigned bits = static_cast<unsigned>(std::countr_zero(params.avg_size));
+        const uint64_t strict = top_bits(bits + 2);
+        const uint64_t loose = top_bits(bits - 2);
+
+        uint64_t h = 0;
+        size_t i = params.min_size;
+        for (; i < normal; i++) {
+            h = (h << 1) + GEAR[std::to_integer<uint8_t>(data[i])];
+            if ((h & strict) == 0) {
+                return i + 1;
+            }
+        }
+        for (; i < end; i++) {
+            h = (h << 1) + GEAR[std::to_integer<uint8_t>(data[i])];
+            if ((h & loose) == 0) {
+                return i + 1;
+            }
+        }
+        return end;
+    }
+
+    struct Chunker::Impl {
+        Impl(ChunkSink sink, const Params& params, unsigned threads)
+            : sink(std::move(sink)), params(checked(params)), pool(threads) {}
+
+        // Hashes a chunk that stays valid until flush() on a worker.
+        void submit(std::span<const std::byte> data) {
+            Chunk& chunk = pending.emplace_back(Chunk{offset, data.size(), {}});
+            offset += data.size();
+            pool.submit([&chunk, data] { chunk.digest = sha1::to_digest(sha1::Hasher().update(data).finalize()); });
+        }
+
+        // Hashes a chunk that is about to be overwritten right here.
+        void hash_now(std::span<const std::byte> data) {
+            pending.push_back(Chunk{offset, data.size(), sha1::to_digest(sha1::Hasher().update(data).finalize())});
+            offset += data.size();
+        }
+
+        void flush() {
+            pool.wait();
+            for (const Chunk& chunk : pending) {
+                sink(chunk);
+            }
+            pending.clear();
+        }
+
+        ChunkSink sink;
+        const Params params;
+        std::deque<Chunk> pending;    // Chunks cut but not yet passed on; a deque so workers keep their slot
+        std::vector<std::byte> carry; // Start of a chunk whose end is not decided yet, always < max_size
+        uint64_t offset = 0;
+        utils::ThreadPool pool;       // Last, so its workers are gone before anything they write to
+    };
+
+    Chunker::Chunker(ChunkSink sink, const Params& params, unsigned threads)
+        : impl(std::make_unique<Impl>(std::move(sink), params, threads)) {}
+
+    Chunker::~Chunker() = default;
+
+    Chunker& Chunker::update(std::span<const std::byte> data) {
+        Impl& s = *impl;
+        const size_t max = s.params.max_size;
+        size_t pos = 0;
+        try {
+            // Finish the chunk left over from the last call, copying only what it takes to place its end.
+            while (!s.carry.empty() && pos < data.size()) {
+                const size_t kept = s.carry.size();
+                const size_t take = std::min(max - kept, data.size() - pos);
+                s.carry.insert(s.carry.end(), data.begin() + pos, data.begin() + pos + take);
+                if (s.carry.size() < max) {
+                    pos += take;
+                    break;
+                }
+                const size_t len = cut(s.carry, s.params);
+                s.hash_now(std::span(s.carry).first(len));
+                if (len >= kept) {
+                    pos += len - kept;
+                    s.carry.clear();
+                } else {
+                    // The cut fell inside the old bytes: keep the rest of them, give back what was taken.
+                    s.carry.erase(s.carry.begin(), s.carry.begin() + len);
+                    s.carry.resize(s.carry.size() - take);
+                }
+            }
+            // Everything else is cut and hashed where it lies.
+            while (s.carry.empty() && data.size() - pos >= max) {
+                const size_t len = cut(data.subspan(pos), s.params);
+                s.submit(data.subspan(pos, len));
+                pos += len;
+            }
+            s.carry.insert(s.carry.end(), data.begin() + pos, data.end());
+            s.flush();
+        } catch (...) {
+            s.pool.wait(); // Workers may still be reading `data`
+            throw;
+        }
+        return *this;
+    }
+
+    void Chunker::finalize() {
+        Impl& s = *impl;
+        while (!s.carry.empty()) {
+            const size_t len = cut(s.carry, s.params);
+            s.hash_now(std::span(s.carry).first(len));
+            s.carry.erase(s.carry.begin(), s.carry.begin() + len);
+        }
+        s.flush();
+    }
+
+    std::vector<Chunk> chunk(std::span<const std::byte> data, const Params& params, unsigned threads) {
+        std::vector<Chunk> chunks;
+        Chunker chunker([&chunks](const Chunk& c) { chunks.push_back(c); }, params, threads);
+        chunker.update(data);
+        chunker.finalize();
+        return chunks;
+    }
+
+    void chunk_fd(int fd, const std::string& name, const ChunkSink& sink, const Params& params, unsigned threads) {
+        Chunker chunker(sink, params, threads);
+        utils::read_all(fd, [&chunker](std::span<const std::byte> data) { chunker.update(data); }, name);
+        chunker.finalize();
+    }
+
+    void chunk_file(const std::string& path, const ChunkSink& sink, const Params& params, unsigned threads) {
+        if (path == "-") {
+            chunk_fd(STDIN_FILENO, "-", sink, params, threads);
+            return;
+        }
+        utils::File file(path);
+        chunk_fd(file.fd(), path, sink, params, threads);
+    }
+}
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <util/file.h>
+#include <util/thread_pool.h>
+
+#include <hash/dedup.h>
+
+namespace hash::dedup {
+    namespace {
+        struct Candidate {
+            std::string path;
+            uint64_t size;
+            sha1::Digest digest; // Edge digest after round 2, full digest after round 3
+            bool failed = false;
+        };
+
+        class Walk {
+        public:
+            Walk(Report& report, uint64_t min_size) : report(report), min_size(min_size) {}
+
+            void visit(const std::string& path) {
+                struct stat st;
+                if (lstat(path.c_str(), &st) != 0) {
+                    report.errors.push_back("Failed to stat " + path + ": " + std::strerror(errno));
+                    return;
+                }
+                if (S_ISDIR(st.st_mode)) {
+                    list(path);
+                } else if (S_ISREG(st.st_mode)) {
+                    // Hard links share an inode; the first path seen stands for all of them.
+                    if (!inodes.insert({static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino)}).second) {
+                        return;
+                    }
+                    report.files++;
+                    report.bytes_total += static_cast<uint64_t>(st.st_size);
+                    if (static_cast<uint64_t>(st.st_size) >= min_size) {
+                        files.push_back(Candidate{path, static_cast<uint64_t>(st.st_size), {}});
+                    }
+                }
+            }
+
+            std::vector<Candidate> files;
+
+        private:
+            void list(const std::string& dir) {
+                std::unique_ptr<DIR, int (*)(DIR*)> handle(opendir(dir.c_str()), closedir);
+                if (!handle) {
+                    report.errors.push_back("Failed to open directory " + dir + ": " + std::strerror(errno));
+                    return;
+                }
+                std::vector<std::string> names;
+                while (dirent* ent = readdir(handle.get())) {
+                    std::string name = ent->d_name;
+                    if (name != "." && name != "..") {
+                        names.push_back(std::move(name));
+                    }
+                }
+                std::sort(names.begin(), names.end()); // Listing order must not leak into the result
+                for (const auto& name : names) {
+                    visit(dir.back() == '/' ? dir + name : dir + "/" + name);
+                }
+            }
+
+            Report& report;
+            uint64_t min_size;
+            std::set<std::pair<uint64_t, uint64_t>> inodes;
+        };
+
+        void read_fully(int fd, std::byte* buf, size_t len, uint64_t offset, const std::string& name) {
+            while (len > 0) {
+                ssize_t n = pread(fd, buf, len, static_cast<off_t>(offset));
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0) {
+                    throw std::runtime_error("Failed to read " + name + ": " + std::strerror(errno));
+                }
+                if (n == 0) {
+                    throw std::runtime_error(name + " shrank while it was being read");
+                }
+                buf += n;
+                len -= static_cast<size_t>(n);
+                offset += static_cast<uint64_t>(n);
+            }
+        }
+
+        // SHA-1 of the first and last `edge` bytes, or of the whole file if that is no more.
+        sha1::Digest edge_digest(const Candidate& c, size_t edge) {
+            utils::File file(c.path);
+            const size_t head = static_cast<size_t>(std::min<uint64_t>(c.size, 2 * uint64_t{edge}));
+            std::vector<std::byte> buf(head);
+            if (c.size <= 2 * uint64_t{edge}) {
+                read_fully(file.fd(), buf.data(), head, 0, c.path);
+            } else {
+                read_fully(file.fd(), buf.data(), edge, 0, c.path);
+                read_fully(file.fd(), buf.data() + edge, edge, c.size - edge, c.path);
+            }
+            return sha1::to_digest(sha1::Hasher().update(buf).finalize());
+        }
+
+        // Keeps only candidates that share (size, digest) with another one, grouped next to each other.
+        void keep_collisions(std::vector<Candidate>& files) {
+            std::erase_if(files, [](const Candidate& c) { return c.failed; });
+            std::sort(files.begin(), files.end(), [](const Candidate& a, const Candidate& b) {
+                return std::tie(b.size, a.digest, a.path) < std::tie(a.size, b.digest, b.path);
+            });
+            std::vector<Candidate> kept;
+            for (size_t i = 0; i < files.size();) {
+                size_t j = i + 1;
+                while (j < files.size() && files[j].size == files[i].size && files[j].digest == files[i].digest) {
+                    j++;
+                }
+                if (j - i > 1) {
+                    std::move(files.begin() + i, files.begin() + j, std::back_inserter(kept));
+                }
+                i = j;
+            }
+            files = std::move(kept);
+        }
+
+        // Runs `fn` on every candidate in parallel; a throw marks that file failed and records why.
+        template<typename Fn>
+        void for_each_file(std::vector<Candidate>& files, unsigned threads, Report& report, Fn fn) {
+            if (files.empty()) {
+                return;
+            }
+            std::mutex mutex;
+            utils::ThreadPool pool(std::min<size_t>(threads == 0 ? utils::ThreadPool::default_threads() : threads,
+                                                    files.size()));
+            utils::parallel_for(pool, files.size(), [&](size_t i) {
+                try {
+                    fn(files[i]);
+                } catch (const std::exception& e) {
+                    files[i].failed = true;
+                    std::lock_guard lock(mutex);
+                    report.errors.push_back(e.what());
+                }
+            });
+        }
+    }
+
+    uint64_t Report::reclaimable() const {
+        uint64_t total = 0;
+        for (const auto& g : groups) {
+            total += g.size * (g.paths.size() - 1);
+        }
+        return total;
+    }
+
+    Report find_duplicates(std::span<const std::string> roots, const Options& opts) {
+        if (opts.edge_bytes == 0) {
+            throw std::invalid_argument("dedup: edge_bytes must be at least 1");
+        }
+        Report report;
+        Walk walk(report, opts.min_size);
+        for (const auto& root : roots) {
+            walk.visit(root);
+        }
+        std::vector<Candidate> files = std::move(walk.files);
+
+        // Round 1: a file with a size nobody else has cannot have a duplicate.
+        std::map<uint64_t, size_t> per_size;
+        for (const auto& c : files) {
+            per_size[c.size]++;
+        }
+        std::erase_if(files, [&](const Candidate& c) { return per_size[c.size] < 2; });
+
+        // Round 2: both ends of each file.
+        std::atomic<uint64_t> bytes_read = 0;
+        for_each_file(files, opts.threads, report, [&](Candidate& c) {
+            c.digest = edge_digest(c, opts.edge_bytes);
+            bytes_read += std::min<uint64_t>(c.size, 2 * uint64_t{opts.edge_bytes});
+        });
+        keep_collisions(files);
+
+        // Round 3: everything that still collides, unless round 2 already saw the whole file.
+        std::vector<Candidate> settled;
+        std::vector<Candidate> large;
+        for (auto& c : files) {
+            (c.size <= 2 * uint64_t{opts.edge_bytes} ? settled : large).push_back(std::move(c));
+        }
+        for_each_file(large, opts.threads, report, [&](Candidate& c) {
+            utils::File file(c.path);
+            c.digest = sha1::to_digest(sha1::hash_fd_raw(file.fd(), c.path));
+            bytes_read += c.size;
+        });
+        keep_collisions(large);
+        report.bytes_read = bytes_read.load();
+
+        // Both lists come out of keep_collisions() with equal files next to each other.
+        for (auto* list : {&settled, &large}) {
+            for (size_t i = 0; i < list->size(); i++) {
+                Candidate& c = (*list)[i];
+                if (i == 0 || (*list)[i - 1].size != c.size || (*list)[i - 1].digest != c.digest) {
+                    report.groups.push_back(Group{c.size, c.digest, {}});
+                }
+                report.groups.back().paths.push_back(std::move(c.path));
+            }
+        }
+        std::sort(report.groups.begin(), report.groups.end(), [](const Group& a, const Group& b) {
+            return std::tie(b.size, a.paths.front()) < std::tie(a.size, b.paths.front());
+        });
+        std::sort(report.errors.begin(), report.errors.end());
+        return report;
+    }
+}
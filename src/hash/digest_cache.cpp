@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <util/file.h>
+
+#include <hash/digest_cache.h>
+
+namespace hash::sha1 {
+    namespace {
+        /**
+         * Layout of the index file. Integers are stored in native byte order; an index written
+         * on a machine of the other endianness fails the byte_order check and reads as empty.
+         *
+         *   header  magic[8] version:u32 byte_order:u32 record_size:u32 reserved:u32
+         *           capacity:u64 count:u64, zero padded to 64 bytes
+         *   record  dev:u64 ino:u64 size:u64 mtime_ns:i64 ctime_ns:i64 digest[20] used:u32
+         */
+        constexpr char MAGIC[8] = {'B', 'O', 'O', 'G', 'I', 'E', 'D', 'C'};
+        constexpr uint32_t VERSION = 1;
+        constexpr uint32_t ENDIAN_MARK = 0x01020304;
+        constexpr size_t HEADER_SIZE = 64;
+        constexpr size_t RECORD_SIZE = 64;
+        constexpr uint64_t MIN_CAPACITY = 64;
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;
+            uint32_t record_size;
+            uint32_t reserved;
+            uint64_t capacity;
+            uint64_t count;
+            std::byte padding[HEADER_SIZE - 40];
+        };
+
+        struct Record {
+            FileStamp stamp;
+            Digest digest;
+            uint32_t used;
+        };
+
+        static_assert(sizeof(Header) == HEADER_SIZE);
+        static_assert(sizeof(FileStamp) == 40 && sizeof(Record) == RECORD_SIZE);
+
+        // Home slot of a file. splitmix64 finaliser, so sequential inodes spread over the table.
+        uint64_t slot_of(uint64_t dev, uint64_t ino, uint64_t capacity) {
+            uint64_t x = ino ^ (dev * 0x9E3779B97F4A7C15ull);
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+            x ^= x >> 31;
+            return x & (capacity - 1);
+        }
+
+        // Whether `slot` of the index file image at `image` holds a record. Reads the whole word,
+        // since which of its bytes is non-zero depends on the host's byte order.
+        bool slot_used(const std::byte* image, uint64_t slot) {
+            uint32_t used;
+            std::memcpy(&used, image + HEADER_SIZE + slot * RECORD_SIZE + offsetof(Record, used), sizeof(used));
+            return used != 0;
+        }
+
+        int64_t to_ns(const struct timespec& ts) {
+            return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+        }
+
+        int64_t now_ns() {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            return to_ns(ts);
+        }
+
+        std::array<uint32_t, 5> to_raw(const Digest& digest) {
+            std::array<uint32_t, 5> raw_hash;
+            for (size_t i = 0; i < raw_hash.size(); i++) {
+                raw_hash[i] = 0;
+                for (size_t j = 0; j < 4; j++) {
+                    raw_hash[i] = (raw_hash[i] << 8) | std::to_integer<uint32_t>(digest[i * 4 + j]);
+                }
+            }
+            return raw_hash;
+        }
+
+        std::runtime_error cache_error(const std::string& what, const std::string& name) {
+            return std::runtime_error(what + " " + name + ": " + std::strerror(errno));
+        }
+
+        void write_fully(int fd, const std::byte* data, size_t len, const std::string& name) {
+            while (len > 0) {
+                ssize_t n = write(fd, data, len);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw cache_error("Failed to write", name);
+                }
+                data += n;
+                len -= static_cast<size_t>(n);
+            }
+        }
+
+        // Closes an fd on scope exit; the flock on a lock file goes with it.
+        struct FdGuard {
+            int fd;
+            ~FdGuard() {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+        };
+    }
+
+    FileStamp FileStamp::of(const struct stat& st) {
+        return FileStamp{static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino),
+                         static_cast<uint64_t>(st.st_size), to_ns(st.st_mtim), to_ns(st.st_ctim)};
+    }
+
+    DigestCache::DigestCache(std::string path) : path(std::move(path)) {
+        map();
+    }
+
+    DigestCache::~DigestCache() {
+        unmap();
+    }
+
+    void DigestCache::map() {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        FdGuard guard{fd};
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < HEADER_SIZE) {
+            return;
+        }
+        void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            return;
+        }
+
+        // Anything that does not look exactly like an index we wrote is ignored and later replaced.
+        Header header;
+        std::memcpy(&header, addr, sizeof(header));
+        const bool valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION
+                           && header.byte_order == ENDIAN_MARK && header.record_size == RECORD_SIZE
+                           && std::has_single_bit(header.capacity) && header.count <= header.capacity
+                           && static_cast<uint64_t>(st.st_size) == HEADER_SIZE + header.capacity * RECORD_SIZE;
+        if (!valid) {
+            munmap(addr, static_cast<size_t>(st.st_size));
+            return;
+        }
+        madvise(addr, static_cast<size_t>(st.st_size), MADV_RANDOM);
+        data = static_cast<const std::byte*>(addr);
+        data_len = static_cast<size_t>(st.st_size);
+        capacity = header.capacity;
+        count = header.count;
+        if (prune) {
+            seen = std::make_unique<std::atomic<bool>[]>(capacity);
+        }
+    }
+
+    void DigestCache::unmap() {
+        if (data != nullptr) {
+            munmap(const_cast<std::byte*>(data), data_len);
+        }
+        data = nullptr;
+        data_len = 0;
+        capacity = 0;
+        count = 0;
+        seen.reset();
+    }
+
+    void DigestCache::set_prune(bool prune) {
+        this->prune = prune;
+        seen = prune && capacity > 0 ? std::make_unique<std::atomic<bool>[]>(capacity) : nullptr;
+    }
+
+    std::optional<Digest> DigestCache::lookup(const FileStamp& stamp) const {
+        if (refresh) {
+            misses++;
+            return std::nullopt;
+        }
+        for (uint64_t probe = 0, slot = capacity ? slot_of(stamp.dev, stamp.ino, capacity) : 0; probe < capacity;
+             probe++, slot = (slot + 1) & (capacity - 1)) {
+            Record record;
+            std::memcpy(&record, data + HEADER_SIZE + slot * RECORD_SIZE, sizeof(record));
+            if (!record.used) {
+                break;
+            }
+            if (record.stamp.dev == stamp.dev && record.stamp.ino == stamp.ino) {
+                if (record.stamp == stamp) {
+                    if (seen) {
+                        seen[slot].store(true, std::memory_order_relaxed);
+                    }
+                    hits++;
+                    return record.digest;
+                }
+                break; // Same file, different version
+            }
+        }
+        misses++;
+        return std::nullopt;
+    }
+
+    void DigestCache::store(const FileStamp& stamp, const Digest& digest) {
+        std::lock_guard lock(pending_mutex);
+        pending[{stamp.dev, stamp.ino}] = {stamp, digest};
+    }
+
+    std::array<uint32_t, 5> DigestCache::hash_fd(int fd, const std::string& name) {
+        struct stat before;
+        if (fstat(fd, &before) != 0) {
+            throw cache_error("Failed to stat", name);
+        }
+        if (!S_ISREG(before.st_mode)) {
+            return hash_fd_raw(fd, name);
+        }
+
+        const FileStamp stamp = FileStamp::of(before);
+        if (auto digest = lookup(stamp)) {
+            return to_raw(*digest);
+        }
+
+        const int64_t started = now_ns();
+        std::array<uint32_t, 5> raw_hash = hash_fd_raw(fd, name);
+
+        // Only remember digests of files that held still while we read them and are old
+        // enough that another write would have to move their timestamps.
+        struct stat after;
+        if (fstat(fd, &after) == 0 && FileStamp::of(after) == stamp
+            && started - std::max(stamp.mtime_ns, stamp.ctime_ns) >= racy_window_ns) {
+            store(stamp, to_digest(raw_hash));
+        }
+        return raw_hash;
+    }
+
+    void DigestCache::commit() {
+        std::lock_guard pending_lock(pending_mutex);
+        if (pending.empty() && !prune) {
+            return;
+        }
+
+        // What this object used, by key: the table is remapped below and its slots move.
+        std::set<std::pair<uint64_t, uint64_t>> found;
+        for (uint64_t slot = 0; prune && slot < capacity; slot++) {
+            if (seen[slot].load(std::memory_order_relaxed)) {
+                Record record;
+                std::memcpy(&record, data + HEADER_SIZE + slot * RECORD_SIZE, sizeof(record));
+                found.insert({record.stamp.dev, record.stamp.ino});
+            }
+        }
+
+        const std::string lock_path = path + ".lock";
+        FdGuard lock{open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)};
+        if (lock.fd < 0) {
+            throw cache_error("Failed to open", lock_path);
+        }
+        while (flock(lock.fd, LOCK_EX) != 0) {
+            if (errno != EINTR) {
+                throw cache_error("Failed to lock", lock_path);
+            }
+        }
+
+        // Another process may have committed since we mapped, so merge into its latest table.
+        unmap();
+        map();
+
+        std::vector<Record> records;
+        records.reserve(count + pending.size());
+        for (uint64_t slot = 0; slot < capacity; slot++) {
+            Record record;
+            std::memcpy(&record, data + HEADER_SIZE + slot * RECORD_SIZE, sizeof(record));
+            const std::pair key{record.stamp.dev, record.stamp.ino};
+            if (record.used && !pending.contains(key) && (!prune || found.contains(key))) {
+                records.push_back(record);
+            }
+        }
+        if (pending.empty() && records.size() == count) {
+            return; // Pruning found nothing to drop
+        }
+        for (const auto& [key, entry] : pending) {
+            records.push_back(Record{entry.first, entry.second, 1});
+        }
+
+        // Keep the table at most half full so probe chains stay short.
+        const uint64_t new_capacity = std::max(MIN_CAPACITY, std::bit_ceil(2 * static_cast<uint64_t>(records.size())));
+        std::vector<std::byte> image(HEADER_SIZE + new_capacity * RECORD_SIZE);
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.byte_order = ENDIAN_MARK;
+        header.record_size = RECORD_SIZE;
+        header.capacity = new_capacity;
+        header.count = records.size();
+        std::memcpy(image.data(), &header, sizeof(header));
+        for (const Record& record : records) {
+            uint64_t slot = slot_of(record.stamp.dev, record.stamp.ino, new_capacity);
+            while (slot_used(image.data(), slot)) {
+                slot = (slot + 1) & (new_capacity - 1);
+            }
+            std::memcpy(image.data() + HEADER_SIZE + slot * RECORD_SIZE, &record, sizeof(record));
+        }
+
+        // Write beside the old index and rename over it, so readers see either table but never half of one.
+        const std::string tmp_path = path + ".tmp";
+        {
+            FdGuard tmp{open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)};
+            if (tmp.fd < 0) {
+                throw cache_error("Failed to create", tmp_path);
+            }
+            write_fully(tmp.fd, image.data(), image.size(), tmp_path);
+            if (fsync(tmp.fd) != 0) {
+                throw cache_error("Failed to sync", tmp_path);
+            }
+        }
+        if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+            throw cache_error("Failed to replace", path);
+        }
+
+        pending.clear();
+        unmap();
+        map();
+    }
+
+    std::string hash_file(const std::string& path, DigestCache& cache) {
+        utils::File file(path);
+        return to_hex(cache.hash_fd(file.fd(), path));
+    }
+}
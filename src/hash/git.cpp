@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <util/file.h>
+#include <util/thread_pool.h>
+
+#include <hash/git.h>
+
+namespace hash::git {
+    namespace {
+        sha1::Hasher start_object(std::string_view type, uint64_t size) {
+            sha1::Hasher hasher;
+            hasher.update(type);
+            hasher.update(" ");
+            hasher.update(std::to_string(size));
+            hasher.update(std::string_view("\0", 1));
+            return hasher;
+        }
+
+        ObjectId hash_blob_fd(int fd, const std::string& name) {
+            struct stat st;
+            if (fstat(fd, &st) != 0) {
+                throw std::runtime_error("Failed to stat " + name + ": " + std::strerror(errno));
+            }
+
+            // Pipes have no size up front, so they are the one case that gets buffered (git does the same).
+            if (!S_ISREG(st.st_mode)) {
+                std::vector<std::byte> content;
+                utils::read_all(fd, [&content](std::span<const std::byte> data) {
+                    content.insert(content.end(), data.begin(), data.end());
+                }, name);
+                return blob_id(content);
+            }
+
+            const uint64_t size = static_cast<uint64_t>(st.st_size);
+            sha1::Hasher hasher = start_object("blob", size);
+            uint64_t seen = 0;
+            utils::read_all(fd, [&](std::span<const std::byte> data) {
+                hasher.update(data);
+                seen += data.size();
+            }, name);
+            if (seen != size) {
+                throw std::runtime_error(name + " changed while it was being hashed");
+            }
+            return sha1::to_digest(hasher.finalize());
+        }
+
+        ObjectId hash_symlink(const std::string& path) {
+            std::string target(PATH_MAX, '\0');
+            ssize_t n = readlink(path.c_str(), target.data(), target.size());
+            if (n < 0) {
+                throw std::runtime_error("Failed to read link " + path + ": " + std::strerror(errno));
+            }
+            return blob_id(std::as_bytes(std::span(target.data(), static_cast<size_t>(n))));
+        }
+
+        // Whole contents of a small file, or nothing if it does not exist.
+        std::optional<std::string> read_small_file(const std::string& path) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                return std::nullopt;
+            }
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        std::string_view trim(std::string_view s) {
+            const size_t begin = s.find_first_not_of(" \t\r\n");
+            const size_t end = s.find_last_not_of(" \t\r\n");
+            return begin == std::string_view::npos ? std::string_view() : s.substr(begin, end - begin + 1);
+        }
+
+        // `ref` ("refs/heads/main") from the loose ref files of `git_dir`, then from its packed-refs.
+        std::optional<ObjectId> resolve_ref(const std::string& git_dir, std::string_view ref) {
+            if (auto loose = read_small_file(git_dir + "/" + std::string(ref))) {
+                return sha1::from_hex(trim(*loose));
+            }
+            const auto packed = read_small_file(git_dir + "/packed-refs");
+            if (!packed) {
+                return std::nullopt;
+            }
+            // "<40 hex> <ref>" per line; comments start with '#' and peeled tags with '^'.
+            std::string_view rest = *packed;
+            while (!rest.empty()) {
+                const size_t eol = rest.find('\n');
+                const std::string_view line = rest.substr(0, eol);
+                rest = eol == std::string_view::npos ? std::string_view() : rest.substr(eol + 1);
+                if (line.size() > sha1::HEX_LEN && line[sha1::HEX_LEN] == ' '
+                    && trim(line.substr(sha1::HEX_LEN + 1)) == ref) {
+                    return sha1::from_hex(line.substr(0, sha1::HEX_LEN));
+                }
+            }
+            return std::nullopt;
+        }
+
+        /**
+         * The commit a nested repository at `path` has checked out, which is what git records for
+         * it. `.git` is either the repository itself or, for submodules and worktrees, a file
+         * saying "gitdir: <where it is>".
+         */
+        ObjectId read_head(const std::string& path) {
+            std::string git_dir = path + "/.git";
+            struct stat st;
+            if (stat(git_dir.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+                const std::string link(trim(read_small_file(git_dir).value_or("")));
+                if (!link.starts_with("gitdir: ")) {
+                    throw std::runtime_error(git_dir + " is neither a repository nor a gitdir link");
+                }
+                const std::string target = link.substr(8);
+                git_dir = target.starts_with("/") ? target : path + "/" + target;
+            }
+
+            std::optional<ObjectId> id;
+            if (const auto head = read_small_file(git_dir + "/HEAD")) {
+                const std::string_view value = trim(*head);
+                if (value.starts_with("ref: ")) {
+                    // A worktree keeps its own HEAD but shares the refs of the main repository.
+                    const std::string common = std::string(trim(read_small_file(git_dir + "/commondir").value_or("")));
+                    const std::string refs_dir = common.empty() ? git_dir
+                                                 : common.starts_with("/") ? common : git_dir + "/" + common;
+                    id = resolve_ref(refs_dir, value.substr(5));
+                } else {
+                    id = sha1::from_hex(value); // Detached
+                }
+            }
+            if (!id) {
+                throw std::runtime_error(path + " is a nested repository without a commit checked out");
+            }
+            return *id;
+        }
+
+        // Git orders tree entries by name, but a directory sorts as if its name had a trailing '/'.
+        bool git_order(const TreeEntry& a, const TreeEntry& b) {
+            const size_t n = std::min(a.name.size(), b.name.size());
+            int c = std::memcmp(a.name.data(), b.name.data(), n);
+            if (c != 0) {
+                return c < 0;
+            }
+            auto next = [n](const TreeEntry& e) -> unsigned char {
+                if (e.name.size() > n) {
+                    return static_cast<unsigned char>(e.name[n]);
+                }
+                return e.mode == MODE_TREE ? '/' : '\0';
+            };
+            return next(a) < next(b);
+        }
+
+        /**
+         * A directory in flight. `pending` counts children not yet hashed plus one for the
+         * listing itself; whoever drops it to zero builds the tree and reports to the parent.
+         */
+        struct Dir {
+            std::string path;
+            std::string name;
+            Dir* parent;
+            std::mutex mutex;
+            std::vector<TreeEntry> entries;
+            std::atomic<size_t> pending = 1;
+            ObjectId id;
+            bool empty = false;
+        };
+
+        class TreeWalk {
+        public:
+            explicit TreeWalk(unsigned threads) : pool(threads) {}
+
+            ObjectId run(const std::string& path) {
+                Dir& root = new_dir(path, "", nullptr);
+                pool.submit([this, &root] { guarded([&] { list(root); }); });
+                pool.wait();
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+                return root.id;
+            }
+
+        private:
+            Dir& new_dir(std::string path, std::string name, Dir* parent) {
+                std::lock_guard lock(dirs_mutex);
+                Dir& d = dirs.emplace_back();
+                d.path = std::move(path);
+                d.name = std::move(name);
+                d.parent = parent;
+                return d;
+            }
+
+            // Runs `fn`, keeping the first failure and skipping all work after it.
+            template<typename Fn>
+            void guarded(Fn fn) {
+                if (failed.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                try {
+                    fn();
+                } catch (...) {
+                    std::lock_guard lock(error_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                        failed = true;
+                    }
+                }
+            }
+
+            void list(Dir& dir) {
+                std::unique_ptr<DIR, int (*)(DIR*)> handle(opendir(dir.path.c_str()), closedir);
+                if (!handle) {
+                    throw std::runtime_error("Failed to open directory " + dir.path + ": " + std::strerror(errno));
+                }
+
+                while (dirent* ent = readdir(handle.get())) {
+                    std::string name = ent->d_name;
+                    if (name == "." || name == ".." || name == ".git") {
+                        continue;
+                    }
+                    std::string path = dir.path + "/" + name;
+                    struct stat st;
+                    if (lstat(path.c_str(), &st) != 0) {
+                        throw std::runtime_error("Failed to stat " + path + ": " + std::strerror(errno));
+                    }
+
+                    struct stat git_st;
+                    if (S_ISDIR(st.st_mode) && lstat((path + "/.git").c_str(), &git_st) == 0) {
+                        // A nested repository (a submodule, say) is recorded as a link to its commit.
+                        dir.pending++;
+                        pool.submit([this, &dir, path, name] {
+                            guarded([&] { add_entry(dir, TreeEntry{std::string(MODE_GITLINK), name, read_head(path)}); });
+                        });
+                    } else if (S_ISDIR(st.st_mode)) {
+                        Dir& child = new_dir(path, name, &dir);
+                        dir.pending++;
+                        pool.submit([this, &child] { guarded([&] { list(child); }); });
+                    } else if (S_ISREG(st.st_mode) || S_ISLNK(st.st_mode)) {
+                        std::string_view mode = S_ISLNK(st.st_mode) ? MODE_SYMLINK
+                                                : (st.st_mode & S_IXUSR) ? MODE_EXECUTABLE : MODE_FILE;
+                        dir.pending++;
+                        pool.submit([this, &dir, path, name, mode] {
+                            guarded([&] {
+                                ObjectId id = mode == MODE_SYMLINK ? hash_symlink(path) : hash_blob_file(path);
+                                add_entry(dir, TreeEntry{std::string(mode), name, id});
+                            });
+                        });
+                    }
+                    // Sockets, fifos and devices cannot be added to git, so they are skipped.
+                }
+                child_done(dir); // The listing's own share of `pending`
+            }
+
+            void add_entry(Dir& dir, TreeEntry entry) {
+                {
+                    std::lock_guard lock(dir.mutex);
+                    dir.entries.push_back(std::move(entry));
+                }
+                child_done(dir);
+            }
+
+            // Called once per finished child; the last one closes the directory and walks up.
+            void child_done(Dir& dir) {
+                if (dir.pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                    return;
+                }
+                dir.empty = dir.entries.empty();
+                dir.id = tree_id(std::move(dir.entries));
+                dir.entries = {};
+                if (dir.parent == nullptr) {
+                    return;
+                }
+                if (dir.empty) {
+                    child_done(*dir.parent); // Git has no way to record an empty directory
+                } else {
+                    add_entry(*dir.parent, TreeEntry{std::string(MODE_TREE), dir.name, dir.id});
+                }
+            }
+
+            utils::ThreadPool pool;
+            std::mutex dirs_mutex;
+            std::deque<Dir> dirs; // Deque so references stay valid as it grows
+            std::mutex error_mutex;
+            std::exception_ptr error;
+            std::atomic<bool> failed = false;
+        };
+    }
+
+    ObjectId blob_id(std::span<const std::byte> content) {
+        return sha1::to_digest(start_object("blob", content.size()).update(content).finalize());
+    }
+
+    ObjectId hash_blob_file(const std::string& path) {
+        if (path == "-") {
+            return hash_blob_fd(STDIN_FILENO, "-");
+        }
+        utils::File file(path);
+        return hash_blob_fd(file.fd(), path);
+    }
+
+    ObjectId tree_id(std::vector<TreeEntry> entries) {
+        std::sort(entries.begin(), entries.end(), git_order);
+        uint64_t size = 0;
+        for (const auto& e : entries) {
+            size += e.mode.size() + 1 + e.name.size() + 1 + e.id.size();
+        }
+
+        // Each entry is "<mode> <name>\0" followed by the raw 20-byte ID.
+        sha1::Hasher hasher = start_object("tree", size);
+        for (const auto& e : entries) {
+            hasher.update(e.mode);
+            hasher.update(" ");
+            hasher.update(e.name);
+            hasher.update(std::string_view("\0", 1));
+            hasher.update(e.id);
+        }
+        return sha1::to_digest(hasher.finalize());
+    }
+
+    ObjectId write_tree(const std::string& dir, unsigned threads) {
+        return TreeWalk(threads).run(dir);
+    }
+}
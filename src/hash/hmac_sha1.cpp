@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <hash/hmac_sha1.h>
+
+namespace hash::hmac_sha1 {
+    namespace {
+        constexpr std::byte IPAD{0x36};
+        constexpr std::byte OPAD{0x5c};
+
+        std::array<uint32_t, 5> midstate(const std::array<std::byte, sha1::SHA1_BLOCK_BYTES>& key, std::byte pad) {
+            std::array<std::byte, sha1::SHA1_BLOCK_BYTES> block;
+            for (size_t i = 0; i < block.size(); i++) {
+                block[i] = key[i] ^ pad;
+            }
+            std::array<uint32_t, 5> H = sha1::makeContext().H;
+            sha1::compress(H, block.data(), 1);
+            return H;
+        }
+    }
+
+    Mac::Mac(const std::array<uint32_t, 5>& inner_midstate, const std::array<uint32_t, 5>& outer_midstate)
+        : inner(sha1::makeContext()), outer(outer_midstate) {
+        inner.H = inner_midstate;
+        inner.message_len = sha1::SHA1_BLOCK_BYTES; // K ^ ipad is already in H
+    }
+
+    Digest Mac::finalize() {
+        const Digest inner_digest = sha1::to_digest(sha1::finalize(inner));
+
+        // The outer message is one block behind the midstate plus 20 bytes, so it always pads to one block.
+        std::array<std::byte, sha1::SHA1_BLOCK_BYTES> block;
+        std::copy(inner_digest.begin(), inner_digest.end(), block.begin());
+        sha1::sha1_pad(block, inner_digest.size(), sha1::SHA1_BLOCK_BYTES);
+        std::array<uint32_t, 5> H = outer;
+        sha1::compress(H, block.data(), 1);
+        return sha1::to_digest(H);
+    }
+
+    Key::Key(std::span<const std::byte> key) {
+        std::array<std::byte, sha1::SHA1_BLOCK_BYTES> padded{};
+        if (key.size() > padded.size()) {
+            const Digest hashed = sha1::to_digest(sha1::Hasher().update(key).finalize());
+            std::copy(hashed.begin(), hashed.end(), padded.begin());
+        } else {
+            std::copy(key.begin(), key.end(), padded.begin());
+        }
+        inner = midstate(padded, IPAD);
+        outer = midstate(padded, OPAD);
+    }
+
+    bool Key::verify(std::span<const std::byte> message, const Digest& tag) const {
+        return equal(sign(message), tag);
+    }
+
+    bool equal(std::span<const std::byte> a, std::span<const std::byte> b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        // volatile keeps the compiler from turning the loop into an early-exit memcmp.
+        volatile uint8_t diff = 0;
+        for (size_t i = 0; i < a.size(); i++) {
+            diff = diff | std::to_integer<uint8_t>(a[i] ^ b[i]);
+        }
+        return diff == 0;
+    }
+
+    bool verify_many(const Key& key, std::span<const std::span<const std::byte>> messages,
+                     std::span<const Digest> tags, std::span<bool> ok) {
+        if (messages.size() != tags.size() || messages.size() != ok.size()) {
+            throw std::invalid_argument("verify_many: got " + std::to_string(messages.size()) + " messages, "
+                                        + std::to_string(tags.size()) + " tags and "
+                                        + std::to_string(ok.size()) + " results");
+        }
+        bool all = true;
+        for (size_t i = 0; i < messages.size(); i++) {
+            ok[i] = key.verify(messages[i], tags[i]);
+            all &= ok[i];
+        }
+        return all;
+    }
+}
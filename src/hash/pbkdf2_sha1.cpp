@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <util/thread_pool.h>
+
+#include <hash/pbkdf2_sha1.h>
+#include <hash/sha1_backend.h>
+#include <hash/stats_counters.h>
+
+namespace hash::pbkdf2_sha1 {
+    namespace {
+        using sha1::backend::Kernel;
+        using sha1::backend::LaneKernel;
+
+        constexpr size_t DIGEST_WORDS = 5;
+        constexpr uint64_t MAX_BLOCKS = 0xFFFFFFFF; // (2^32 - 1) * hLen bytes, RFC 8018 step 1
+
+        // One output block of one request.
+        struct Job {
+            const hmac_sha1::Key* key;
+            std::span<const std::byte> salt;
+            uint32_t index; // 1-based, as hashed into U_1
+            std::span<std::byte> out;
+        };
+
+        inline void store_be32(std::byte* p, uint32_t w) {
+            if constexpr (std::endian::native == std::endian::little) {
+                w = std::byteswap(w);
+            }
+            std::memcpy(p, &w, sizeof(w));
+        }
+
+        inline uint32_t load_be32(const std::byte* p) {
+            uint32_t w;
+            std::memcpy(&w, p, sizeof(w));
+            if constexpr (std::endian::native == std::endian::little) {
+                w = std::byteswap(w);
+            }
+            return w;
+        }
+
+        // The inner and outer HMAC inputs after U_1: a digest in bytes 0..19, then fixed padding for 84 bytes.
+        std::array<std::byte, sha1::SHA1_BLOCK_BYTES> digest_block() {
+            std::array<std::byte, sha1::SHA1_BLOCK_BYTES> block{};
+            sha1::sha1_pad(block, sha1::DIGEST_LEN, sha1::SHA1_BLOCK_BYTES);
+            return block;
+        }
+
+        // U_1 = HMAC(P, S || INT(i)), the only iteration whose input is not a single digest.
+        std::array<uint32_t, DIGEST_WORDS> first_u(const Job& job) {
+            std::byte index[4];
+            store_be32(index, job.index);
+            const sha1::Digest u = job.key->begin().update(job.salt).update(std::span(index)).finalize();
+            std::array<uint32_t, DIGEST_WORDS> words;
+            for (size_t j = 0; j < DIGEST_WORDS; j++) {
+                words[j] = load_be32(u.data() + 4 * j);
+            }
+            return words;
+        }
+
+        void write_out(const Job& job, const uint32_t* t, size_t stride) {
+            std::byte bytes[sha1::DIGEST_LEN];
+            for (size_t j = 0; j < DIGEST_WORDS; j++) {
+                store_be32(bytes + 4 * j, t[j * stride]);
+            }
+            std::copy_n(bytes, job.out.size(), job.out.begin());
+        }
+
+        // The kernels picked for one derive_many() call, and the counters their blocks go to.
+        struct Kernels {
+            Kernel scalar;
+            stats::Counter scalar_counter;
+            LaneKernel lanes; // Null when the batch backend is Scalar
+        };
+
+        void run_scalar(const Job& job, uint32_t iterations, Kernel kernel, stats::Counter counter) {
+            const auto& inner = job.key->inner_midstate();
+            const auto& outer = job.key->outer_midstate();
+            std::array<std::byte, sha1::SHA1_BLOCK_BYTES> block = digest_block();
+
+            std::array<uint32_t, DIGEST_WORDS> u = first_u(job);
+            std::array<uint32_t, DIGEST_WORDS> t = u;
+            for (uint32_t c = 1; c < iterations; c++) {
+                for (size_t j = 0; j < DIGEST_WORDS; j++) {
+                    store_be32(block.data() + 4 * j, u[j]);
+                }
+                std::array<uint32_t, DIGEST_WORDS> H = inner;
+                kernel(H.data(), block.data(), 1);
+                for (size_t j = 0; j < DIGEST_WORDS; j++) {
+                    store_be32(block.data() + 4 * j, H[j]);
+                }
+                u = outer;
+                kernel(u.data(), block.data(), 1);
+                for (size_t j = 0; j < DIGEST_WORDS; j++) {
+                    t[j] ^= u[j];
+                }
+            }
+            stats::add(counter, 2 * uint64_t{iterations - 1});
+            write_out(job, t.data(), 1);
+        }
+
+        /**
+         * N jobs in lock step, one per lane, with the state word-major like sha1_lanes.h wants.
+         * Every job has the same iteration count, so no lane ever idles until the end. Lanes past
+         * the end of `jobs` repeat the first job and their result is dropped.
+         */
+        template<size_t N>
+        void run_lanes(std::span<const Job> jobs, uint32_t iterations, LaneKernel kernel, stats::Counter counter) {
+            alignas(64) uint32_t inner[DIGEST_WORDS * N];
+            alignas(64) uint32_t outer[DIGEST_WORDS * N];
+            alignas(64) uint32_t u[DIGEST_WORDS * N];
+            alignas(64) uint32_t t[DIGEST_WORDS * N];
+            alignas(64) uint32_t state[DIGEST_WORDS * N];
+            std::array<std::array<std::byte, sha1::SHA1_BLOCK_BYTES>, N> blocks;
+            const std::byte* block_ptrs[N];
+
+            for (size_t l = 0; l < N; l++) {
+                const Job& job = jobs[l < jobs.size() ? l : 0];
+                const auto first = first_u(job);
+                for (size_t j = 0; j < DIGEST_WORDS; j++) {
+                    inner[j * N + l] = job.key->inner_midstate()[j];
+                    outer[j * N + l] = job.key->outer_midstate()[j];
+                    u[j * N + l] = t[j * N + l] = first[j];
+                }
+                blocks[l] = digest_block();
+                block_ptrs[l] = blocks[l].data();
+            }
+
+            auto load_blocks = [&](const uint32_t* words) {
+                for (size_t l = 0; l < N; l++) {
+                    for (size_t j = 0; j < DIGEST_WORDS; j++) {
+                        store_be32(blocks[l].data() + 4 * j, words[j * N + l]);
+                    }
+                }
+            };
+
+            for (uint32_t c = 1; c < iterations; c++) {
+                load_blocks(u);
+                std::memcpy(state, inner, sizeof(state));
+                kernel(state, block_ptrs);
+                load_blocks(state);
+                std::memcpy(u, outer, sizeof(u));
+                kernel(u, block_ptrs);
+                for (size_t i = 0; i < DIGEST_WORDS * N; i++) {
+                    t[i] ^= u[i];
+                }
+            }
+            stats::add(counter, 2 * jobs.size() * uint64_t{iterations - 1}); // Not the repeated lanes
+            for (size_t l = 0; l < jobs.size(); l++) {
+                write_out(jobs[l], t + l, N);
+            }
+        }
+
+        size_t lanes_of(sha1::BatchBackend b) {
+            switch (b) {
+                case sha1::BatchBackend::Avx512:
+                    return 16;
+                case sha1::BatchBackend::Avx2:
+                    return 8;
+                case sha1::BatchBackend::Scalar:
+                    return 1;
+            }
+            return 1;
+        }
+
+        void run_group(std::span<const Job> group, uint32_t iterations, sha1::BatchBackend batch, const Kernels& kernels) {
+            switch (batch) {
+                case sha1::BatchBackend::Avx512:
+                    run_lanes<16>(group, iterations, kernels.lanes, stats::Counter::BlocksAvx512);
+                    break;
+                case sha1::BatchBackend::Avx2:
+                    run_lanes<8>(group, iterations, kernels.lanes, stats::Counter::BlocksAvx2);
+                    break;
+                case sha1::BatchBackend::Scalar:
+                    for (const Job& job : group) {
+                        run_scalar(job, iterations, kernels.scalar, kernels.scalar_counter);
+                    }
+                    break;
+            }
+        }
+    }
+
+    void derive_many(std::span<const Request> requests, uint32_t iterations, unsigned threads) {
+        if (iterations == 0) {
+            throw std::invalid_argument("pbkdf2: iteration count must be at least 1");
+        }
+
+        std::vector<hmac_sha1::Key> keys;
+        keys.reserve(requests.size());
+        std::vector<Job> jobs;
+        for (const Request& r : requests) {
+            const uint64_t blocks = (r.out.size() + sha1::DIGEST_LEN - 1) / sha1::DIGEST_LEN;
+            if (blocks > MAX_BLOCKS) {
+                throw std::invalid_argument("pbkdf2: derived key too long");
+            }
+            const hmac_sha1::Key& key = keys.emplace_back(r.password);
+            for (uint64_t i = 0; i < blocks; i++) {
+                const size_t offset = i * sha1::DIGEST_LEN;
+                jobs.push_back(Job{&key, r.salt, static_cast<uint32_t>(i + 1),
+                                   r.out.subspan(offset, std::min(sha1::DIGEST_LEN, r.out.size() - offset))});
+            }
+        }
+
+        // Resolved once here so the iteration loops call the kernels directly.
+        // A mostly idle lane group is slower than one block at a time, so go wide only with a full one.
+        sha1::BatchBackend batch = sha1::active_batch_backend();
+        const LaneKernel lanes_kernel = sha1::backend::lane_kernel(batch);
+        if (jobs.size() < lanes_of(batch) || lanes_kernel == nullptr) {
+            batch = sha1::BatchBackend::Scalar;
+        }
+        const sha1::Backend backend = sha1::active_backend();
+        const Kernels kernels{sha1::backend::kernel(backend),
+                              backend == sha1::Backend::ShaNi ? stats::Counter::BlocksShaNi
+                                                              : stats::Counter::BlocksPortable,
+                              batch == sha1::BatchBackend::Scalar ? nullptr : lanes_kernel};
+        const size_t lanes = lanes_of(batch);
+        const size_t groups = (jobs.size() + lanes - 1) / lanes;
+        auto group = [&](size_t g) {
+            return std::span<const Job>(jobs).subspan(g * lanes, std::min(lanes, jobs.size() - g * lanes));
+        };
+
+        if (groups <= 1) {
+            for (size_t g = 0; g < groups; g++) {
+                run_group(group(g), iterations, batch, kernels);
+            }
+            return;
+        }
+        utils::ThreadPool pool(std::min<size_t>(threads == 0 ? utils::ThreadPool::default_threads() : threads, groups));
+        utils::parallel_for(pool, groups, [&](size_t g) { run_group(group(g), iterations, batch, kernels); });
+    }
+
+    void derive(std::span<const std::byte> password, std::span<const std::byte> salt, uint32_t iterations,
+                std::span<std::byte> out, unsigned threads) {
+        const Request request{password, salt, out};
+        derive_many(std::span(&request, 1), iterations, threads);
+    }
+}
@@ -1,25 +1,44 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
-#include <optional>
-#include <cassert>
-#include <fstream>
+#include <bit>
+#include <cstring>
+#include <utility>
+#include <stdexcept>
 
-#include <util/utils.h>
+#include <util/cpu.h>
+#include <util/file.h>
 
 #include <hash/sha1.h>
+#include <hash/sha1_backend.h>
+#include <hash/stats_counters.h>
 
 namespace hash::sha1 {
 
     std::string hash_string(const std::string& data) {
-        std::istringstream iss(data);
-        return hash_stream(iss);
+        return to_hex(hash(data));
+    }
+
+    Digest hash(std::span<const std::byte> data) {
+        Sha1_context ctx = makeContext();
+        update(ctx, data);
+        return to_digest(finalize(ctx));
+    }
+
+    std::array<uint32_t, 5> hash_fd_raw(int fd, const std::string& name) {
+        auto ctx = makeContext();
+        utils::read_all(fd, [&ctx](std::span<const std::byte> data) { update(ctx, data); }, name);
+        return finalize(ctx);
+    }
+
+    std::string hash_fd(int fd) {
+        return to_hex(hash_fd_raw(fd, "fd " + std::to_string(fd)));
     }
 
     std::string hash_file(const std::string& path) {
-        std::ifstream ifs(path, std::ios::binary);
-        if (!ifs) {
-            throw std::runtime_error("Failed to open file: " + path);
-        }
-        return hash_stream(ifs);
+        utils::File file(path);
+        return to_hex(hash_fd_raw(file.fd(), path));
     }
 
     /** 
@@ -29,186 +48,269 @@ namespace hash::sha1 {
      * Padding should be a '1' followed by `m` '0's followed by a 64-bit int
      * this should produce a message of length 512 * `n`. The 64-bit int is the
      * length of the original message. The padded message is then processed by
-     * SHA-1 as `n` 512-bit blocks.
+     * SHA-1 as `n` 512-bit blocks. See md::pad().
+     *
+     * `buf` holds the last `message_end_pos` bytes of the message and must have room for
+     * padded_len(message_end_pos) bytes. `message_len` is the number of bytes that came before them.
      * 
      * Returns the size of the final padded buffer.
     */
-    uint sha1_pad(std::vector<char>& buf, uint64_t message_end_pos, uint64_t message_len) {
-        message_len += message_end_pos; // We must add the characters that we have read in this chunk iteration
-        constexpr size_t block_size = SHA1_BLOCK_LEN / utils::BYTE_LEN;
-
-        // The total length must be a multiple of block_size (64 bytes)
-        size_t min_len = message_end_pos + 1 + 8; // 1 for 0x80, 8 for length
-        // The total length must be a multiple of block_size (64 bytes or 512 bits)
-        size_t resize_len = ((min_len + block_size - 1) / block_size) * block_size;
-
-        buf.resize(std::max(resize_len, block_size));
-        assert(buf.size() % 64 == 0);
-        uint i = message_end_pos;
-        auto append = [&i](std::vector<char>& buf, uint8_t elem) {
-            buf[i++] = elem;
-        };
+    size_t sha1_pad(std::span<std::byte> buf, size_t message_end_pos, uint64_t message_len) {
+        return md::pad<Traits>(buf, message_end_pos, message_len);
+    }
 
-        // Append 1 (0x80)
-        // len is wrong here.
-        append(buf, 0x80);
+    namespace {
+        constexpr char STATE_MAGIC[4] = {'B', 'S', 'H', '1'};
 
-        // Pad with 0s
-        // This should append until you are 64 bits (2 words) short of a multiple of 512.
-        // This extra space is for the 2 word sized length the be appended.
-        auto length_pad = (2 * SHA1_WORD_LEN) / utils::BYTE_LEN;
-        while ((i + length_pad) % (SHA1_BLOCK_LEN / utils::BYTE_LEN) != 0) {
-            append(buf, 0x00);
+        void put_be(std::byte* p, uint64_t v, size_t bytes) {
+            for (size_t i = 0; i < bytes; i++) {
+                p[i] = static_cast<std::byte>(v >> (8 * (bytes - 1 - i)));
+            }
         }
 
-        // Append buf length to padded buf. 
-        auto bit_len = message_len * utils::BYTE_LEN;
-        for (int j = 0; j < utils::BYTE_LEN; ++j) {
-            int shift = ((utils::BYTE_LEN - 1) - j) * utils::BYTE_LEN;
-
-            // Grab a byte by shifting over i times and masking.
-            uint8_t byte = static_cast<uint8_t>((bit_len >> shift) & 0xFF);
-
-            append(buf, byte);
+        uint64_t get_be(const std::byte* p, size_t bytes) {
+            uint64_t v = 0;
+            for (size_t i = 0; i < bytes; i++) {
+                v = (v << 8) | std::to_integer<uint64_t>(p[i]);
+            }
+            return v;
         }
-
-        return i;
     }
 
-    std::shared_ptr<std::vector<uint32_t>> toMessageDigestBuffer(const std::vector<char>& padded_message, uint64_t padded_buffer_size) {
-        std::vector<uint32_t> m_digest_buffer;
-        size_t num_words = padded_buffer_size / 4;
-        m_digest_buffer.reserve(num_words);
+    size_t export_state(const Sha1_context& ctx, std::span<std::byte> out) {
+        const size_t len = STATE_HEADER_BYTES + ctx.block_len;
+        if (out.size() < len) {
+            throw std::invalid_argument("export_state: need " + std::to_string(len) + " bytes, got "
+                                        + std::to_string(out.size()));
+        }
+        std::byte* p = out.data();
+        std::memcpy(p, STATE_MAGIC, sizeof(STATE_MAGIC));
+        put_be(p + 4, STATE_VERSION, 1);
+        put_be(p + 5, ctx.block_len, 1);
+        put_be(p + 6, 0, 2);
+        for (size_t i = 0; i < ctx.H.size(); i++) {
+            put_be(p + 8 + 4 * i, ctx.H[i], 4);
+        }
+        put_be(p + 28, ctx.message_len, 8);
+        std::copy_n(ctx.block.data(), ctx.block_len, p + STATE_HEADER_BYTES);
+        return len;
+    }
 
-        for (size_t i = 0; i < num_words; ++i) {
-            uint32_t w = 0;
-            for (size_t j = 0; j < 4; ++j) {
-                size_t byte_index = i * 4 + j; // Index should be shifted a word (4 bytes) and 'j' over.
-                if (byte_index < padded_message.size()) {
-                    w |= (static_cast<uint32_t>(static_cast<unsigned char>(padded_message[byte_index])) << ((3 - j) * 8));
-                } else {
-                    return nullptr;
-                }
-            }
-            m_digest_buffer.push_back(w);
+    Sha1_context import_state(std::span<const std::byte> state) {
+        if (state.size() < STATE_HEADER_BYTES || std::memcmp(state.data(), STATE_MAGIC, sizeof(STATE_MAGIC)) != 0) {
+            throw std::invalid_argument("import_state: not a SHA-1 state");
         }
-        return std::make_shared<std::vector<uint32_t>>(m_digest_buffer);
+        const std::byte* p = state.data();
+        if (get_be(p + 4, 1) != STATE_VERSION) {
+            throw std::invalid_argument("import_state: unsupported state version " + std::to_string(get_be(p + 4, 1)));
+        }
+        Sha1_context ctx = makeContext();
+        ctx.block_len = get_be(p + 5, 1);
+        ctx.message_len = get_be(p + 28, 8);
+        // The tail is whatever did not fill a block, so its length follows from the total.
+        if (get_be(p + 6, 2) != 0 || ctx.block_len != ctx.message_len % SHA1_BLOCK_BYTES
+            || state.size() != STATE_HEADER_BYTES + ctx.block_len) {
+            throw std::invalid_argument("import_state: malformed SHA-1 state");
+        }
+        for (size_t i = 0; i < ctx.H.size(); i++) {
+            ctx.H[i] = static_cast<uint32_t>(get_be(p + 8 + 4 * i, 4));
+        }
+        std::copy_n(p + STATE_HEADER_BYTES, ctx.block_len, ctx.block.data());
+        return ctx;
     }
 
     Sha1_context makeContext() {
         Sha1_context ctx;
-        // TODO find a more efficient way to zero init a buffer.
-        for (size_t i = 0; i < ctx.w.size(); i++) {
-            ctx.w[i] = 0;
-        }
+        ctx.block_len = 0;
         ctx.message_len = 0;
         return ctx;
     }
 
-    std::optional<uint32_t> f(uint t, uint32_t B, uint32_t C, uint32_t D) {
-        if (t <= 19) {
-            return (B & C) | ((~B) & D);
+    void update(Sha1_context& ctx, std::span<const std::byte> data) {
+        stats::add(stats::Counter::BytesHashed, data.size());
+        md::update(ctx, data);
+    }
+
+    std::array<uint32_t, 5> finalize(Sha1_context& ctx) {
+        return md::finalize(ctx);
+    }
+
+    namespace {
+        /**
+         * f(t;B,C,D) and K(t) from RFC 3174 section 5, resolved per round group at compile time
+         * so the unrolled rounds carry no range checks.
+         */
+        template<int t>
+        constexpr uint32_t f(uint32_t B, uint32_t C, uint32_t D) {
+            static_assert(t >= 0 && t <= 79);
+            if constexpr (t <= 19) {
+                return D ^ (B & (C ^ D));         // (B AND C) OR ((NOT B) AND D)
+            } else if constexpr (t >= 40 && t <= 59) {
+                return (B & C) | (D & (B | C));   // (B AND C) OR (B AND D) OR (C AND D)
+            } else {
+                return B ^ C ^ D;
+            }
+        }
+
+        template<int t>
+        constexpr uint32_t K() {
+            static_assert(t >= 0 && t <= 79);
+            if constexpr (t <= 19) {
+                return K_1;
+            } else if constexpr (t <= 39) {
+                return K_2;
+            } else if constexpr (t <= 59) {
+                return K_3;
+            } else {
+                return K_4;
+            }
         }
-        if (t >= 20 && t <= 39) {
-            return B ^ C ^ D;
+
+        inline uint32_t load_be32(const std::byte* p) {
+            uint32_t w;
+            std::memcpy(&w, p, sizeof(w));
+            if constexpr (std::endian::native == std::endian::little) {
+                w = std::byteswap(w);
+            }
+            return w;
         }
-        if (t >= 40 && t <= 59) {
-            return (B & C) | (B & D) | (C & D);
+
+        /**
+         * Round t of the compression loop.
+         *
+         * Rather than shuffling E = D; D = C; ... after every round, the five registers stay put
+         * in `v` and the round index decides which slot plays which part: A is v[-t mod 5], B is
+         * v[1-t mod 5] and so on. TEMP is written straight into E's slot, which is where the next
+         * round looks for A.
+         *
+         * W(t) only ever reaches back 16 words, so `w` is a rolling window: W(t) lives in
+         * w[t mod 16] and is expanded in place, right before it is used.
+         */
+        template<int t>
+        [[gnu::always_inline]] inline void round(uint32_t (&v)[5], uint32_t (&w)[16], const std::byte* block) {
+            constexpr auto slot = [](int r) { return ((r - t) % 5 + 5) % 5; };
+            uint32_t& A = v[slot(0)];
+            uint32_t& B = v[slot(1)];
+            uint32_t& C = v[slot(2)];
+            uint32_t& D = v[slot(3)];
+            uint32_t& E = v[slot(4)];
+
+            if constexpr (t < 16) {
+                // a. Divide M(i) into 16 words W(0), W(1), ... , W(15)
+                w[t] = load_be32(block + 4 * t);
+            } else {
+                // b. W(t) = S^1(W(t-3) XOR W(t-8) XOR W(t-14) XOR W(t-16))
+                w[t % 16] = std::rotl(w[(t - 3) % 16] ^ w[(t - 8) % 16] ^ w[(t - 14) % 16] ^ w[t % 16], 1);
+            }
+
+            // d. TEMP = S^5(A) + f(t;B,C,D) + E + W(t) + K(t); C = S^30(B)
+            E += std::rotl(A, 5) + f<t>(B, C, D) + w[t % 16] + K<t>();
+            B = std::rotl(B, 30);
         }
-        if (t >= 60 && t<= 79) {
-            return B ^ C ^ D;
+
+        template<int... t>
+        [[gnu::always_inline]] inline void rounds(uint32_t (&v)[5], uint32_t (&w)[16], const std::byte* block,
+                                                  std::integer_sequence<int, t...>) {
+            (round<t>(v, w, block), ...);
         }
-        return std::nullopt;
     }
 
-    // TODO could make this more performant.
-    std::optional<uint32_t> K(int t) {
-        if (t <= 19) {
-            return K_1;
-        } else if (t >= 20 && t <= 39) {
-            return K_2;
-        } else if (t >= 40 && t <= 59) {
-            return K_3;
-        } else if (t >= 60 && t <= 79) {
-            return K_4;
+    /**
+     * Runs the SHA-1 compression function over `num_blocks` consecutive 512-bit blocks.
+     * https://datatracker.ietf.org/doc/html/rfc3174#section-6.1
+     *
+     * This is the reference kernel every other backend is checked against, and the one used
+     * where no SIMD or SHA extensions are available. All 80 rounds are unrolled at compile time.
+     */
+    void backend::compress_portable(uint32_t* H, const std::byte* blocks, size_t num_blocks) {
+        for (size_t block_index = 0; block_index < num_blocks; block_index++) {
+            const std::byte* block = blocks + block_index * SHA1_BLOCK_BYTES;
+
+            uint32_t v[5] = {H[0], H[1], H[2], H[3], H[4]};
+            uint32_t w[16];
+            rounds(v, w, block, std::make_integer_sequence<int, 80>{});
+
+            // e. Let H0 = H0 + A, H1 = H1 + B, H2 = H2 + C, H3 = H3 + D, H4 = H4 + E.
+            // After 80 rounds (a multiple of 5) every register is back in its starting slot.
+            H[0] += v[0];
+            H[1] += v[1];
+            H[2] += v[2];
+            H[3] += v[3];
+            H[4] += v[4];
         }
-        return std::nullopt;
     }
 
-    // TODO reference the chunk (data) instead of copy
-    void process(Sha1_context& ctx, std::vector<char> data, size_t buffer_size, bool is_last_chunk) {
-        if (is_last_chunk) {
-            buffer_size = sha1_pad(data, buffer_size, ctx.message_len);
+    namespace {
+        Backend detect_backend() {
+            // BOOGIE_SHA1_BACKEND=portable forces the fallback, e.g. to check it on a machine with SHA-NI.
+            if (const char* forced = std::getenv("BOOGIE_SHA1_BACKEND")) {
+                for (Backend b : {Backend::Portable, Backend::ShaNi}) {
+                    if (backend_name(b) == forced && backend_supported(b)) {
+                        return b;
+                    }
+                }
+            }
+            return backend_supported(Backend::ShaNi) ? Backend::ShaNi : Backend::Portable;
         }
 
-        auto digest_buffer = toMessageDigestBuffer(data, buffer_size);
-        if (!digest_buffer) {
-            // TODO err condition
-            return;
+        std::atomic<Backend>& selected_backend() {
+            static std::atomic<Backend> selected{detect_backend()};
+            return selected;
         }
-        //TODO the digest buffer does not need to be carried between stream iterations.
-        // Remove Sha1_context::m 
-        ctx.m = std::move(digest_buffer);
-
-        // ctx.m has uint32_t elements
-        const auto words_per_block = SHA1_BLOCK_LEN / SHA1_WORD_LEN;
-        // For each block
-        for (size_t block_index = 0; block_index < ctx.m->size() / words_per_block; block_index++) {
-            ctx.b1[0] = ctx.H[0];
-            ctx.b1[1] = ctx.H[1];
-            ctx.b1[2] = ctx.H[2];
-            ctx.b1[3] = ctx.H[3];
-            ctx.b1[4] = ctx.H[4];
-
-            uint32_t& A = ctx.b1[0];
-            uint32_t& B = ctx.b1[1];
-            uint32_t& C = ctx.b1[2];
-            uint32_t& D = ctx.b1[3];
-            uint32_t& E = ctx.b1[4];
-
-            // Load the current 16 words of the block into w[0]..w[15]
-            for (int i = 0; i < words_per_block; i++) {
-                size_t word_index = block_index * words_per_block + i;
-                ctx.w[i] = (*ctx.m)[word_index];
-            }
+    }
 
-            /**
-             * b. For t = 16 to 79 let
-             *  W(t) = S^1(W(t-3) XOR W(t-8) XOR W(t-14) XOR W(t-16)).
-             */
-            for (int t = 16; t <= 79; t++) {
-                uint32_t w_t = ctx.w[t - 3] ^ ctx.w[t - 8] ^ ctx.w[t - 14]  ^ ctx.w[t - 16];
-                w_t = (w_t << 1) | (w_t >> (32 - 1));
-                ctx.w[t] = w_t;
-            }
+    bool backend_supported(Backend b) {
+        switch (b) {
+            case Backend::Portable:
+                return true;
+            case Backend::ShaNi:
+                return utils::cpu::has_sha_ni();
+        }
+        return false;
+    }
 
-            /**
-             * d. For t = 0 to 79 do
-             *   TEMP = S^5(A) + f(t;B,C,D) + E + W(t) + K(t);
-             *   E = D;  D = C;  C = S^30(B);  B = A; A = TEMP;
-             */
-            for (int t = 0; t <= 79; t++) {
-                ctx.temp = ((A << 5) | (A >> (32 - 5))) // S^5(A)
-                        + f(t, B, C, D).value()      // f(t; B, C, D)
-                        + E                          // + E
-                        + ctx.w[t]                   // + W(t)
-                        + K(t).value();              // + K(t)
-
-                // Update registers
-                E = D;
-                D = C;
-                C = (B << 30) | (B >> (32 - 30)); // S^30(B)
-                B = A;
-                A = ctx.temp;
-            }
+    std::string_view backend_name(Backend b) {
+        switch (b) {
+            case Backend::Portable:
+                return "portable";
+            case Backend::ShaNi:
+                return "sha-ni";
+        }
+        return "unknown";
+    }
+
+    Backend active_backend() {
+        return selected_backend().load(std::memory_order_relaxed);
+    }
 
-            //e. Let H0 = H0 + A, H1 = H1 + B, H2 = H2 + C, H3 = H3 + D, H4 = H4 + E.
-            ctx.H[0] += A;
-            ctx.H[1] += B;
-            ctx.H[2] += C;
-            ctx.H[3] += D;
-            ctx.H[4] += E;
+    bool set_backend(Backend b) {
+        if (!backend_supported(b)) {
+            return false;
+        }
+        selected_backend().store(b, std::memory_order_relaxed);
+        return true;
+    }
+
+    backend::Kernel backend::kernel(Backend b) {
+        switch (b) {
+            case Backend::ShaNi:
+#ifdef BOOGIE_X86_KERNELS
+                return compress_shani;
+#else
+                break; // Never supported here, see backend_supported()
+#endif
+            case Backend::Portable:
+                return compress_portable;
+        }
+        return compress_portable;
+    }
+
+    void compress(std::array<uint32_t, 5>& H, const std::byte* blocks, size_t num_blocks) {
+        if (num_blocks == 0) {
+            return;
         }
-        ctx.message_len += buffer_size;
+        const Backend b = active_backend();
+        stats::add(b == Backend::ShaNi ? stats::Counter::BlocksShaNi : stats::Counter::BlocksPortable, num_blocks);
+        backend::kernel(b)(H.data(), blocks, num_blocks);
     }
 }
\ No newline at end of file
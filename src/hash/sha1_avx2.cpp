@@ -0,0 +1,17 @@
+// 8-lane multi-buffer SHA-1. Built for AVX2 and only reached after utils::cpu::has_avx2().
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC target("avx2")
+
+#include <hash/sha1_backend.h>
+#include <hash/sha1_lanes.h>
+
+namespace hash::sha1::backend {
+    typedef uint32_t u32x8 __attribute__((vector_size(32)));
+
+    void compress_x8_avx2(uint32_t* state, const std::byte* const* blocks) {
+        compress_lanes<u32x8>(state, blocks);
+    }
+}
+
+#endif
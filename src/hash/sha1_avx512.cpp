@@ -0,0 +1,17 @@
+// 16-lane multi-buffer SHA-1. Built for AVX-512F and only reached after utils::cpu::has_avx512().
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC target("avx512f")
+
+#include <hash/sha1_backend.h>
+#include <hash/sha1_lanes.h>
+
+namespace hash::sha1::backend {
+    typedef uint32_t u32x16 __attribute__((vector_size(64)));
+
+    void compress_x16_avx512(uint32_t* state, const std::byte* const* blocks) {
+        compress_lanes<u32x16>(state, blocks);
+    }
+}
+
+#endif
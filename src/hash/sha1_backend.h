@@ -0,0 +1,46 @@
+#ifndef SHA1_BACKEND_H
+#define SHA1_BACKEND_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <util/cpu.h>
+
+namespace hash::sha1 {
+    enum class Backend;
+    enum class BatchBackend;
+}
+
+// Compression kernels behind hash::sha1::compress(). Each one runs `num_blocks`
+// consecutive 512-bit blocks and folds them into the 5 word state `H`.
+namespace hash::sha1::backend {
+    using Kernel = void (*)(uint32_t* H, const std::byte* blocks, size_t num_blocks);
+
+    void compress_portable(uint32_t* H, const std::byte* blocks, size_t num_blocks);
+
+#ifdef BOOGIE_X86_KERNELS
+    // Only call this when utils::cpu::has_sha_ni() is true.
+    void compress_shani(uint32_t* H, const std::byte* blocks, size_t num_blocks);
+#endif
+
+    // The kernel behind `b`. Use this rather than naming a kernel, so only one place needs to
+    // know which of them exist on this target.
+    Kernel kernel(Backend b);
+
+    /**
+     * Multi-buffer kernels: one block from each of 8 (or 16) independent messages.
+     * `state` is word-major, state[j * lanes + l] being H(j) of lane l, see sha1_lanes.h.
+     * Only call these when utils::cpu::has_avx2() / has_avx512() is true.
+     */
+    using LaneKernel = void (*)(uint32_t* state, const std::byte* const* blocks);
+
+#ifdef BOOGIE_X86_KERNELS
+    void compress_x8_avx2(uint32_t* state, const std::byte* const* blocks);
+    void compress_x16_avx512(uint32_t* state, const std::byte* const* blocks);
+#endif
+
+    // The multi-buffer kernel behind `b`, null for Scalar and wherever `b` is not built.
+    LaneKernel lane_kernel(BatchBackend b);
+}
+
+#endif // SHA1_BACKEND_H
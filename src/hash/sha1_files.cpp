@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <numeric>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <util/file.h>
+#include <util/thread_pool.h>
+
+#include <hash/digest_cache.h>
+#include <hash/sha1.h>
+
+namespace hash::sha1 {
+    namespace {
+        FileResult hash_one(const std::string& path, DigestCache* cache) {
+            FileResult result;
+            try {
+                if (path == "-") {
+                    result.raw_hash = hash_fd_raw(STDIN_FILENO, "-");
+                } else {
+                    utils::File file(path);
+                    result.raw_hash = cache ? cache->hash_fd(file.fd(), path) : hash_fd_raw(file.fd(), path);
+                }
+            } catch (const std::exception& e) {
+                result.error = e.what();
+            }
+            return result;
+        }
+
+        // Size used only for scheduling; anything we cannot stat sorts as empty and fails later.
+        off_t size_hint(const std::string& path) {
+            struct stat st;
+            if (path == "-" || stat(path.c_str(), &st) != 0) {
+                return 0;
+            }
+            return st.st_size;
+        }
+    }
+
+    void hash_files(std::span<const std::string> paths, unsigned threads,
+                    const std::function<void(size_t, const FileResult&)>& on_result,
+                    DigestCache* cache) {
+        std::vector<off_t> sizes(paths.size());
+        std::transform(paths.begin(), paths.end(), sizes.begin(), size_hint);
+        std::vector<size_t> order(paths.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+        std::vector<FileResult> results(paths.size());
+        std::vector<char> done(paths.size(), false);
+        std::mutex mutex;
+        std::condition_variable finished;
+
+        utils::ThreadPool pool(std::min<size_t>(threads == 0 ? utils::ThreadPool::default_threads() : threads,
+                                                std::max<size_t>(paths.size(), 1)));
+        for (size_t index : order) {
+            pool.submit([&, index] {
+                FileResult result = hash_one(paths[index], cache);
+                std::lock_guard lock(mutex);
+                results[index] = std::move(result);
+                done[index] = true;
+                finished.notify_one();
+            });
+        }
+
+        // Report in input order while the pool keeps working on later files.
+        for (size_t i = 0; i < paths.size(); i++) {
+            {
+                std::unique_lock lock(mutex);
+                finished.wait(lock, [&] { return done[i] != 0; });
+            }
+            on_result(i, results[i]);
+            results[i] = FileResult{}; // Release the error string early
+        }
+        pool.wait();
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef SHA1_LANES_H
+#define SHA1_LANES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Word-sliced SHA-1 for the multi-buffer kernels. Every vector holds one 32-bit word of
+ * N independent messages, lane l belonging to message l, so the 80 rounds run once for all
+ * of them. Each SIMD translation unit includes this after picking its target and
+ * instantiates compress_lanes() with its own GCC vector type.
+ */
+namespace hash::sha1::backend {
+    namespace {
+        template<typename V>
+        inline V rotl(V x, int n) {
+            return (x << n) | (x >> (32 - n));
+        }
+
+        inline uint32_t load_be32(const std::byte* p) {
+            uint32_t w;
+            std::memcpy(&w, p, sizeof(w));
+            return __builtin_bswap32(w);
+        }
+
+        /**
+         * `state` holds the five H words of all lanes, word-major: state[j * N + l] is H(j)
+         * of lane l. `blocks[l]` points at the next 64-byte block of lane l.
+         */
+        template<typename V>
+        inline void compress_lanes(uint32_t* state, const std::byte* const* blocks) {
+            constexpr size_t N = sizeof(V) / sizeof(uint32_t);
+
+            // Transpose the 16 message words of every lane into one vector per word.
+            alignas(sizeof(V)) uint32_t words[16][N];
+            for (size_t l = 0; l < N; l++) {
+                for (size_t t = 0; t < 16; t++) {
+                    words[t][l] = load_be32(blocks[l] + 4 * t);
+                }
+            }
+            V w[16];
+            for (size_t t = 0; t < 16; t++) {
+                std::memcpy(&w[t], words[t], sizeof(V));
+            }
+
+            V h[5];
+            std::memcpy(h, state, sizeof(h));
+            V a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+            // W(t) for t >= 16 only ever needs the last 16 words, so the schedule rolls in place.
+            auto schedule = [&w](int t) -> V {
+                if (t >= 16) {
+                    w[t & 15] = rotl(w[(t - 3) & 15] ^ w[(t - 8) & 15] ^ w[(t - 14) & 15] ^ w[t & 15], 1);
+                }
+                return w[t & 15];
+            };
+            auto round = [&](V f, uint32_t k, int t) {
+                V temp = rotl(a, 5) + f + e + schedule(t) + k;
+                e = d;
+                d = c;
+                c = rotl(b, 30);
+                b = a;
+                a = temp;
+            };
+
+            for (int t = 0; t < 20; t++) {
+                round(d ^ (b & (c ^ d)), 0x5A827999, t);
+            }
+            for (int t = 20; t < 40; t++) {
+                round(b ^ c ^ d, 0x6ED9EBA1, t);
+            }
+            for (int t = 40; t < 60; t++) {
+                round((b & c) | (d & (b | c)), 0x8F1BBCDC, t);
+            }
+            for (int t = 60; t < 80; t++) {
+                round(b ^ c ^ d, 0xCA62C1D6, t);
+            }
+
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+            std::memcpy(state, h, sizeof(h));
+        }
+    }
+}
+
+#endif // SHA1_LANES_H
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <util/cpu.h>
+
+#include <hash/sha1.h>
+#include <hash/sha1_backend.h>
+#include <hash/stats_counters.h>
+
+namespace hash::sha1 {
+    namespace {
+        /**
+         * One message in flight on a SIMD lane. Whole blocks are read straight from the
+         * message; the last partial block and its padding are staged in `tail`.
+         */
+        struct Lane {
+            const std::byte* next;
+            size_t full_blocks;
+            std::array<std::byte, 2 * SHA1_BLOCK_BYTES> tail;
+            size_t tail_blocks;
+            size_t tail_pos;
+            size_t message;
+
+            void start(size_t index, std::span<const std::byte> data) {
+                message = index;
+                next = data.data();
+                full_blocks = data.size() / SHA1_BLOCK_BYTES;
+                size_t rem = data.size() % SHA1_BLOCK_BYTES;
+                std::copy_n(data.data() + full_blocks * SHA1_BLOCK_BYTES, rem, tail.data());
+                tail_blocks = sha1_pad(tail, rem, full_blocks * SHA1_BLOCK_BYTES) / SHA1_BLOCK_BYTES;
+                tail_pos = 0;
+            }
+
+            const std::byte* next_block() {
+                if (full_blocks > 0) {
+                    full_blocks--;
+                    const std::byte* block = next;
+                    next += SHA1_BLOCK_BYTES;
+                    return block;
+                }
+                return tail.data() + SHA1_BLOCK_BYTES * tail_pos++;
+            }
+
+            bool done() const { return full_blocks == 0 && tail_pos == tail_blocks; }
+        };
+
+        /**
+         * Drives an N lane kernel over the whole batch. Lanes that run out of messages are
+         * fed a dummy block whose result is thrown away.
+         */
+        template<size_t N>
+        void hash_many_lanes(std::span<const std::span<const std::byte>> messages, std::span<Digest> out,
+                             backend::LaneKernel kernel, stats::Counter counter) {
+            static constexpr std::array<std::byte, SHA1_BLOCK_BYTES> idle_block{};
+
+            alignas(64) uint32_t state[5 * N];
+            std::array<Lane, N> lanes;
+            std::array<bool, N> busy{};
+            const std::byte* blocks[N];
+            size_t next_message = 0;
+            size_t num_busy = 0;
+
+            auto refill = [&](size_t l) {
+                busy[l] = next_message < messages.size();
+                if (busy[l]) {
+                    stats::add(stats::Counter::BytesHashed, messages[next_message].size());
+                    lanes[l].start(next_message, messages[next_message]);
+                    next_message++;
+                    for (size_t j = 0; j < 5; j++) {
+                        state[j * N + l] = Traits::IV[j];
+                    }
+                }
+                return busy[l];
+            };
+
+            for (size_t l = 0; l < N; l++) {
+                num_busy += refill(l);
+            }
+
+            while (num_busy > 0) {
+                for (size_t l = 0; l < N; l++) {
+                    blocks[l] = busy[l] ? lanes[l].next_block() : idle_block.data();
+                }
+                kernel(state, blocks);
+                stats::add(counter, num_busy); // The idle block is not part of any message
+                for (size_t l = 0; l < N; l++) {
+                    if (!busy[l] || !lanes[l].done()) {
+                        continue;
+                    }
+                    std::array<uint32_t, 5> H;
+                    for (size_t j = 0; j < 5; j++) {
+                        H[j] = state[j * N + l];
+                    }
+                    out[lanes[l].message] = to_digest(H);
+                    num_busy -= !refill(l);
+                }
+            }
+        }
+
+        void hash_many_scalar(std::span<const std::span<const std::byte>> messages, std::span<Digest> out) {
+            for (size_t i = 0; i < messages.size(); i++) {
+                out[i] = to_digest(Hasher().update(messages[i]).finalize());
+            }
+        }
+
+        BatchBackend detect_batch_backend() {
+            // BOOGIE_SHA1_BATCH_BACKEND works like BOOGIE_SHA1_BACKEND does for compress().
+            if (const char* forced = std::getenv("BOOGIE_SHA1_BATCH_BACKEND")) {
+                for (BatchBackend b : {BatchBackend::Scalar, BatchBackend::Avx2, BatchBackend::Avx512}) {
+                    if (backend_name(b) == forced && backend_supported(b)) {
+                        return b;
+                    }
+                }
+            }
+            if (backend_supported(BatchBackend::Avx512)) {
+                return BatchBackend::Avx512;
+            }
+            // A single SHA-NI stream keeps up with eight AVX2 lanes, so only go wide without it.
+            if (backend_supported(BatchBackend::Avx2) && !backend_supported(Backend::ShaNi)) {
+                return BatchBackend::Avx2;
+            }
+            return BatchBackend::Scalar;
+        }
+
+        std::atomic<BatchBackend>& selected_batch_backend() {
+            static std::atomic<BatchBackend> selected{detect_batch_backend()};
+            return selected;
+        }
+    }
+
+    bool backend_supported(BatchBackend b) {
+        switch (b) {
+            case BatchBackend::Scalar:
+                return true;
+            case BatchBackend::Avx2:
+                return utils::cpu::has_avx2();
+            case BatchBackend::Avx512:
+                return utils::cpu::has_avx512();
+        }
+        return false;
+    }
+
+    std::string_view backend_name(BatchBackend b) {
+        switch (b) {
+            case BatchBackend::Scalar:
+                return "scalar";
+            case BatchBackend::Avx2:
+                return "avx2";
+            case BatchBackend::Avx512:
+                return "avx512";
+        }
+        return "unknown";
+    }
+
+    BatchBackend active_batch_backend() {
+        return selected_batch_backend().load(std::memory_order_relaxed);
+    }
+
+    bool set_backend(BatchBackend b) {
+        if (!backend_supported(b)) {
+            return false;
+        }
+        selected_batch_backend().store(b, std::memory_order_relaxed);
+        return true;
+    }
+
+    backend::LaneKernel backend::lane_kernel(BatchBackend b) {
+#ifdef BOOGIE_X86_KERNELS
+        switch (b) {
+            case BatchBackend::Avx512:
+                return compress_x16_avx512;
+            case BatchBackend::Avx2:
+                return compress_x8_avx2;
+            case BatchBackend::Scalar:
+                break;
+        }
+#else
+        (void)b;
+#endif
+        return nullptr;
+    }
+
+    void hash_many(std::span<const std::span<const std::byte>> messages, std::span<Digest> out) {
+        if (messages.size() != out.size()) {
+            throw std::invalid_argument("hash_many: got " + std::to_string(messages.size()) + " messages but "
+                                        + std::to_string(out.size()) + " digests");
+        }
+        const BatchBackend b = active_batch_backend();
+        const backend::LaneKernel kernel = backend::lane_kernel(b);
+        if (kernel == nullptr) {
+            hash_many_scalar(messages, out);
+        } else if (b == BatchBackend::Avx512) {
+            hash_many_lanes<16>(messages, out, kernel, stats::Counter::BlocksAvx512);
+        } else {
+            hash_many_lanes<8>(messages, out, kernel, stats::Counter::BlocksAvx2);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+// SHA-1 compression on the x86 SHA extensions (sha1rnds4, sha1nexte, sha1msg1, sha1msg2).
+// The whole translation unit is built for sha/ssse3/sse4.1, so keep it free of anything
+// the rest of the library might share (inline std:: templates and the like). It is only
+// ever reached after utils::cpu::has_sha_ni() said yes.
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC target("sha,ssse3,sse4.1")
+
+#include <immintrin.h>
+#include <utility>
+
+#include <hash/sha1_backend.h>
+
+namespace hash::sha1::backend {
+    namespace {
+        struct Lanes {
+            __m128i abcd;
+            __m128i e0;
+            __m128i e1;
+            __m128i msg[4];
+        };
+
+        /**
+         * One group of four rounds. sha1rnds4 runs the rounds, sha1nexte derives the next E
+         * from the old A, and sha1msg1/xor/sha1msg2 stretch W(t) four words at a time, three
+         * groups ahead of where it is consumed. Group g consumes msg[g % 4].
+         */
+        template<int g>
+        __attribute__((always_inline)) inline void rounds(Lanes& s, const std::byte* block, __m128i bswap_mask) {
+            __m128i& cur = s.msg[g % 4];
+            __m128i& e_in = (g % 2 == 0) ? s.e0 : s.e1;
+            __m128i& e_out = (g % 2 == 0) ? s.e1 : s.e0;
+
+            if constexpr (g < 4) {
+                cur = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * g)), bswap_mask);
+            }
+            if constexpr (g == 0) {
+                e_in = _mm_add_epi32(e_in, cur);
+            } else {
+                e_in = _mm_sha1nexte_epu32(e_in, cur);
+            }
+            e_out = s.abcd;
+            if constexpr (g >= 3 && g <= 18) {
+                s.msg[(g + 1) % 4] = _mm_sha1msg2_epu32(s.msg[(g + 1) % 4], cur);
+            }
+            s.abcd = _mm_sha1rnds4_epu32(s.abcd, e_in, g / 5);
+            if constexpr (g >= 1 && g <= 16) {
+                s.msg[(g + 3) % 4] = _mm_sha1msg1_epu32(s.msg[(g + 3) % 4], cur);
+            }
+            if constexpr (g >= 2 && g <= 17) {
+                s.msg[(g + 2) % 4] = _mm_xor_si128(s.msg[(g + 2) % 4], cur);
+            }
+        }
+
+        template<int... g>
+        __attribute__((always_inline)) inline void all_rounds(Lanes& s, const std::byte* block, __m128i bswap_mask,
+                                                              std::integer_sequence<int, g...>) {
+            (rounds<g>(s, block, bswap_mask), ...);
+        }
+    }
+
+    void compress_shani(uint32_t* H, const std::byte* blocks, size_t num_blocks) {
+        const __m128i bswap_mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+        // The instructions want A in the top lane and E alone in the top lane of its own register.
+        Lanes s;
+        s.abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(H)), 0x1B);
+        s.e0 = _mm_set_epi32(static_cast<int>(H[4]), 0, 0, 0);
+
+        for (size_t block_index = 0; block_index < num_blocks; block_index++) {
+            const __m128i abcd_save = s.abcd;
+            const __m128i e_save = s.e0;
+
+            all_rounds(s, blocks + block_index * 64, bswap_mask, std::make_integer_sequence<int, 20>{});
+
+            s.e0 = _mm_sha1nexte_epu32(s.e0, e_save);
+            s.abcd = _mm_add_epi32(s.abcd, abcd_save);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(H), _mm_shuffle_epi32(s.abcd, 0x1B));
+        H[4] = static_cast<uint32_t>(_mm_extract_epi32(s.e0, 3));
+    }
+}
+
+#endif
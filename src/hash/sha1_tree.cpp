@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include <util/file.h>
+#include <util/thread_pool.h>
+
+#include <hash/sha1_tree.h>
+
+namespace hash::sha1::tree {
+    struct TreeHasher::Impl {
+        explicit Impl(unsigned threads) : pool(threads), batch_bytes(pool.size() * LEAF_SIZE) {}
+
+        // Appends the digests of the leaves `data` splits into. Only the last one may be short.
+        void hash_leaves(std::span<const std::byte> data) {
+            const size_t first = leaves.size();
+            const size_t n = (data.size() + LEAF_SIZE - 1) / LEAF_SIZE;
+            leaves.resize(first + n);
+            utils::parallel_for(pool, n, [&](size_t i) {
+                const size_t offset = i * LEAF_SIZE;
+                leaves[first + i] = leaf_digest(data.subspan(offset, std::min(LEAF_SIZE, data.size() - offset)));
+            });
+        }
+
+        utils::ThreadPool pool;
+        const size_t batch_bytes;
+        std::vector<std::byte> pending; // Input not yet hashed, never more than one batch
+        std::vector<Digest> leaves;
+    };
+
+    Digest leaf_digest(std::span<const std::byte> leaf) {
+        return to_digest(Hasher().update(std::span(&LEAF_PREFIX, 1)).update(leaf).finalize());
+    }
+
+    Digest node_digest(const Digest& left, const Digest& right) {
+        return to_digest(Hasher().update(std::span(&NODE_PREFIX, 1)).update(left).update(right).finalize());
+    }
+
+    Digest root_of(std::span<const Digest> leaves) {
+        if (leaves.empty()) {
+            throw std::invalid_argument("sha1-tree: a tree has at least one leaf");
+        }
+        std::vector<Digest> level(leaves.begin(), leaves.end());
+        while (level.size() > 1) {
+            size_t out = 0;
+            for (size_t i = 0; i + 1 < level.size(); i += 2) {
+                level[out++] = node_digest(level[i], level[i + 1]);
+            }
+            if (level.size() % 2 == 1) {
+                level[out++] = level.back(); // Unpaired node moves up as is
+            }
+            level.resize(out);
+        }
+        return level[0];
+    }
+
+    bool verify_range(std::span<const std::byte> data, uint64_t offset, std::span<const Digest> leaves) {
+        if (offset % LEAF_SIZE != 0) {
+            return false;
+        }
+        const uint64_t first = offset / LEAF_SIZE;
+        const uint64_t n = std::max<uint64_t>((data.size() + LEAF_SIZE - 1) / LEAF_SIZE, 1);
+        if (first + n > leaves.size()) {
+            return false;
+        }
+        // A short final leaf is only allowed as the last leaf of the whole input.
+        if (data.size() % LEAF_SIZE != 0 && first + n != leaves.size()) {
+            return false;
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            auto leaf = data.subspan(i * LEAF_SIZE, std::min<uint64_t>(LEAF_SIZE, data.size() - i * LEAF_SIZE));
+            if (leaf_digest(leaf) != leaves[first + i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    TreeHasher::TreeHasher(unsigned threads) : impl(std::make_unique<Impl>(threads)) {}
+
+    TreeHasher::~TreeHasher() = default;
+
+    TreeHasher& TreeHasher::update(std::span<const std::byte> data) {
+        Impl& s = *impl;
+        while (!data.empty()) {
+            // Whole leaves are hashed where they lie once there are enough to keep every worker busy.
+            if (s.pending.empty() && data.size() >= s.batch_bytes) {
+                const size_t whole = data.size() / LEAF_SIZE * LEAF_SIZE;
+                s.hash_leaves(data.first(whole));
+                data = data.subspan(whole);
+                continue;
+            }
+            const size_t take = std::min(s.batch_bytes - s.pending.size(), data.size());
+            s.pending.insert(s.pending.end(), data.begin(), data.begin() + take);
+            data = data.subspan(take);
+            if (s.pending.size() == s.batch_bytes) {
+                s.hash_leaves(s.pending);
+                s.pending.clear();
+            }
+        }
+        return *this;
+    }
+
+    Tree TreeHasher::finalize() {
+        Impl& s = *impl;
+        if (!s.pending.empty()) {
+            s.hash_leaves(s.pending);
+            s.pending.clear();
+        }
+        if (s.leaves.empty()) {
+            s.leaves.push_back(leaf_digest({}));
+        }
+        Tree tree{root_of(s.leaves), std::move(s.leaves)};
+        s.leaves = {};
+        return tree;
+    }
+
+    Tree hash_tree(std::span<const std::byte> data, unsigned threads) {
+        return TreeHasher(threads).update(data).finalize();
+    }
+
+    Tree hash_fd_tree(int fd, const std::string& name, unsigned threads) {
+        TreeHasher hasher(threads);
+        utils::read_all(fd, [&hasher](std::span<const std::byte> data) { hasher.update(data); }, name);
+        return hasher.finalize();
+    }
+
+    Tree hash_file_tree(const std::string& path, unsigned threads) {
+        if (path == "-") {
+            return hash_fd_tree(STDIN_FILENO, "-", threads);
+        }
+        utils::File file(path);
+        return hash_fd_tree(file.fd(), path, threads);
+    }
+
+    std::string hash_file(const std::string& path, unsigned threads) {
+        return to_hex(hash_file_tree(path, threads).root);
+    }
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+#include <util/cpu.h>
+#include <util/file.h>
+
+#include <hash/sha256.h>
+#include <hash/sha256_backend.h>
+#include <hash/stats_counters.h>
+
+namespace hash::sha256 {
+
+    std::string hash_string(const std::string& data) {
+        return to_hex(hash(data));
+    }
+
+    Digest hash(std::span<const std::byte> data) {
+        Sha256_context ctx;
+        update(ctx, data);
+        return finalize(ctx);
+    }
+
+    Digest hash_fd_raw(int fd, const std::string& name) {
+        Sha256_context ctx;
+        utils::read_all(fd, [&ctx](std::span<const std::byte> data) { update(ctx, data); }, name);
+        return finalize(ctx);
+    }
+
+    std::string hash_fd(int fd) {
+        return to_hex(hash_fd_raw(fd, "fd " + std::to_string(fd)));
+    }
+
+    std::string hash_file(const std::string& path) {
+        utils::File file(path);
+        return to_hex(hash_fd_raw(file.fd(), path));
+    }
+
+    void update(Sha256_context& ctx, std::span<const std::byte> data) {
+        stats::add(stats::Counter::BytesHashed, data.size());
+        md::update(ctx, data);
+    }
+
+    Digest finalize(Sha256_context& ctx) {
+        return md::to_digest<Traits>(md::finalize(ctx));
+    }
+
+    // The reference rounds in Traits::block() double as the portable kernel.
+    void backend::compress_portable(uint32_t* H, const std::byte* blocks, size_t num_blocks) {
+        std::array<uint32_t, 8> state = {H[0], H[1], H[2], H[3], H[4], H[5], H[6], H[7]};
+        for (size_t block_index = 0; block_index < num_blocks; block_index++) {
+            Traits::block(state, blocks + block_index * BLOCK_BYTES);
+        }
+        std::copy(state.begin(), state.end(), H);
+    }
+
+    namespace {
+        Backend detect_backend() {
+            // BOOGIE_SHA256_BACKEND=portable forces the fallback, e.g. to check it on a machine with SHA-NI.
+            if (const char* forced = std::getenv("BOOGIE_SHA256_BACKEND")) {
+                for (Backend b : {Backend::Portable, Backend::ShaNi}) {
+                    if (backend_name(b) == forced && backend_supported(b)) {
+                        return b;
+                    }
+                }
+            }
+            return backend_supported(Backend::ShaNi) ? Backend::ShaNi : Backend::Portable;
+        }
+
+        std::atomic<Backend>& selected_backend() {
+            static std::atomic<Backend> selected{detect_backend()};
+            return selected;
+        }
+    }
+
+    bool backend_supported(Backend b) {
+        switch (b) {
+            case Backend::Portable:
+                return true;
+            case Backend::ShaNi:
+                // The SHA CPUID bit covers sha256rnds2 and friends as well as the SHA-1 instructions.
+                return utils::cpu::has_sha_ni();
+        }
+        return false;
+    }
+
+    std::string_view backend_name(Backend b) {
+        switch (b) {
+            case Backend::Portable:
+                return "portable";
+            case Backend::ShaNi:
+                return "sha-ni";
+        }
+        return "unknown";
+    }
+
+    Backend active_backend() {
+        return selected_backend().load(std::memory_order_relaxed);
+    }
+
+    bool set_backend(Backend b) {
+        if (!backend_supported(b)) {
+            return false;
+        }
+        selected_backend().store(b, std::memory_order_relaxed);
+        return true;
+    }
+
+    backend::Kernel backend::kernel(Backend b) {
+        switch (b) {
+            case Backend::ShaNi:
+#ifdef BOOGIE_X86_KERNELS
+                return compress_shani;
+#else
+                break; // Never supported here, see backend_supported()
+#endif
+            case Backend::Portable:
+                return compress_portable;
+        }
+        return compress_portable;
+    }
+
+    void compress(std::array<uint32_t, 8>& H, const std::byte* blocks, size_t num_blocks) {
+        if (num_blocks == 0) {
+            return;
+        }
+        const Backend b = active_backend();
+        stats::add(b == Backend::ShaNi ? stats::Counter::BlocksShaNi : stats::Counter::BlocksPortable, num_blocks);
+        backend::kernel(b)(H.data(), blocks, num_blocks);
+    }
+}
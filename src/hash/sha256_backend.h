@@ -0,0 +1,29 @@
+#ifndef SHA256_BACKEND_H
+#define SHA256_BACKEND_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <util/cpu.h>
+
+namespace hash::sha256 {
+    enum class Backend;
+}
+
+// Compression kernels behind hash::sha256::compress(). Each one runs `num_blocks`
+// consecutive 512-bit blocks and folds them into the 8 word state `H`.
+namespace hash::sha256::backend {
+    using Kernel = void (*)(uint32_t* H, const std::byte* blocks, size_t num_blocks);
+
+    void compress_portable(uint32_t* H, const std::byte* blocks, size_t num_blocks);
+
+#ifdef BOOGIE_X86_KERNELS
+    // Only call this when utils::cpu::has_sha_ni() is true.
+    void compress_shani(uint32_t* H, const std::byte* blocks, size_t num_blocks);
+#endif
+
+    // The kernel behind `b`, like sha1::backend::kernel().
+    Kernel kernel(Backend b);
+}
+
+#endif // SHA256_BACKEND_H
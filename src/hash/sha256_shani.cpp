@@ -0,0 +1,95 @@
+// SHA-256 compression on the x86 SHA extensions (sha256rnds2, sha256msg1, sha256msg2).
+// The whole translation unit is built for sha/ssse3/sse4.1, so keep it free of anything
+// the rest of the library might share (inline std:: templates and the like). It is only
+// ever reached after utils::cpu::has_sha_ni() said yes.
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC target("sha,ssse3,sse4.1")
+
+#include <immintrin.h>
+#include <utility>
+
+#include <hash/sha256_backend.h>
+
+namespace hash::sha256::backend {
+    namespace {
+        alignas(16) constexpr uint32_t ROUND_K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+        };
+
+        struct Lanes {
+            __m128i abef;
+            __m128i cdgh;
+            __m128i msg[4];
+        };
+
+        /**
+         * One group of four rounds. sha256rnds2 runs two rounds, taking W(t) + K(t) from the low
+         * half of its third operand, so each group issues it twice. sha256msg1, alignr/add and
+         * sha256msg2 build W(t) four words at a time, finishing a group right before it is consumed.
+         * Group g consumes msg[g % 4].
+         */
+        template<int g>
+        __attribute__((always_inline)) inline void rounds(Lanes& s, const std::byte* block, __m128i bswap_mask) {
+            __m128i& cur = s.msg[g % 4];
+
+            if constexpr (g < 4) {
+                cur = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * g)), bswap_mask);
+            }
+            __m128i wk = _mm_add_epi32(cur, _mm_load_si128(reinterpret_cast<const __m128i*>(ROUND_K + 4 * g)));
+            s.cdgh = _mm_sha256rnds2_epu32(s.cdgh, s.abef, wk);
+            if constexpr (g >= 3 && g <= 14) {
+                // W(t+4..t+7) needs W(t-3..t) too, which only now exist.
+                __m128i& next = s.msg[(g + 1) % 4];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(cur, s.msg[(g + 3) % 4], 4));
+                next = _mm_sha256msg2_epu32(next, cur);
+            }
+            wk = _mm_shuffle_epi32(wk, 0x0E);
+            s.abef = _mm_sha256rnds2_epu32(s.abef, s.cdgh, wk);
+            if constexpr (g >= 1 && g <= 12) {
+                s.msg[(g + 3) % 4] = _mm_sha256msg1_epu32(s.msg[(g + 3) % 4], cur);
+            }
+        }
+
+        template<int... g>
+        __attribute__((always_inline)) inline void all_rounds(Lanes& s, const std::byte* block, __m128i bswap_mask,
+                                                              std::integer_sequence<int, g...>) {
+            (rounds<g>(s, block, bswap_mask), ...);
+        }
+    }
+
+    void compress_shani(uint32_t* H, const std::byte* blocks, size_t num_blocks) {
+        const __m128i bswap_mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+        // The instructions want the state as ABEF and CDGH, A and C in the top lanes.
+        Lanes s;
+        const __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(H)), 0xB1);
+        const __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(H + 4)), 0x1B);
+        s.abef = _mm_alignr_epi8(cdab, efgh, 8);
+        s.cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+        for (size_t block_index = 0; block_index < num_blocks; block_index++) {
+            const __m128i abef_save = s.abef;
+            const __m128i cdgh_save = s.cdgh;
+
+            all_rounds(s, blocks + block_index * 64, bswap_mask, std::make_integer_sequence<int, 16>{});
+
+            s.abef = _mm_add_epi32(s.abef, abef_save);
+            s.cdgh = _mm_add_epi32(s.cdgh, cdgh_save);
+        }
+
+        const __m128i feba = _mm_shuffle_epi32(s.abef, 0x1B);
+        const __m128i dchg = _mm_shuffle_epi32(s.cdgh, 0xB1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(H), _mm_blend_epi16(feba, dchg, 0xF0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(H + 4), _mm_alignr_epi8(dchg, feba, 8));
+    }
+}
+
+#endif
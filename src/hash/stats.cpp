@@ -0,0 +1,140 @@
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+#include <pthread.h>
+
+#include <hash/sha1.h>
+#include <hash/sha256.h>
+#include <hash/stats_counters.h>
+
+namespace hash::stats {
+    namespace {
+        constexpr size_t N = static_cast<size_t>(Counter::Count);
+
+        // One per thread that ever counted. Linked in place, so attaching a thread never allocates.
+        struct ThreadSlot {
+            Counters counters;
+            ThreadSlot* prev = nullptr;
+            ThreadSlot* next = nullptr;
+        };
+
+        void retire(void* slot);
+
+        // Counters of live threads, plus what finished threads left behind.
+        struct Registry {
+            std::mutex mutex;
+            ThreadSlot* live = nullptr;
+            std::array<uint64_t, N> retired{};
+            // Retires a thread's slot when it exits. A thread_local destructor would do the same, but
+            // registering one costs the C runtime a malloc() on the thread's first count.
+            pthread_key_t exit_key;
+
+            Registry() {
+                if (pthread_key_create(&exit_key, retire) != 0) {
+                    std::abort();
+                }
+            }
+        };
+
+        // Never destroyed: threads may still be exiting, and retiring, after static destructors ran.
+        // Placed in static storage rather than new'd so the first count in the process does not allocate.
+        Registry& registry() {
+            alignas(Registry) static std::byte storage[sizeof(Registry)];
+            static Registry* r = new (storage) Registry;
+            return *r;
+        }
+
+        void retire(void* p) {
+            auto* slot = static_cast<ThreadSlot*>(p);
+            Registry& r = registry();
+            std::lock_guard lock(r.mutex);
+            for (size_t i = 0; i < N; i++) {
+                r.retired[i] += slot->counters.values[i].exchange(0, std::memory_order_relaxed);
+            }
+            (slot->prev ? slot->prev->next : r.live) = slot->next;
+            if (slot->next) {
+                slot->next->prev = slot->prev;
+            }
+            slot->prev = slot->next = nullptr;
+            thread_counters = nullptr; // Counting again from a later exit handler attaches it again
+        }
+
+        std::atomic<uint64_t> allocations = 0;
+    }
+
+    constinit thread_local Counters* thread_counters = nullptr;
+
+    Counters* attach_thread() {
+        // Trivially destructible, so the runtime registers nothing for it either.
+        thread_local ThreadSlot slot;
+        Registry& r = registry();
+        {
+            std::lock_guard lock(r.mutex);
+            slot.next = r.live;
+            if (r.live) {
+                r.live->prev = &slot;
+            }
+            r.live = &slot;
+        }
+        pthread_setspecific(r.exit_key, &slot);
+        thread_counters = &slot.counters;
+        return thread_counters;
+    }
+
+    uint64_t Snapshot::blocks() const {
+        return (*this)[Counter::BlocksPortable] + (*this)[Counter::BlocksShaNi]
+               + (*this)[Counter::BlocksAvx2] + (*this)[Counter::BlocksAvx512];
+    }
+
+    Snapshot snapshot() {
+        Snapshot s;
+        Registry& r = registry();
+        std::lock_guard lock(r.mutex);
+        s.values = r.retired;
+        for (const ThreadSlot* slot = r.live; slot; slot = slot->next) {
+            for (size_t i = 0; i < N; i++) {
+                s.values[i] += slot->counters.values[i].load(std::memory_order_relaxed);
+            }
+        }
+        s.allocations = allocations.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void reset() {
+        Registry& r = registry();
+        std::lock_guard lock(r.mutex);
+        r.retired = {};
+        // Racy against a thread that is counting right now; its in-flight add may survive.
+        for (ThreadSlot* slot = r.live; slot; slot = slot->next) {
+            for (auto& v : slot->counters.values) {
+                v.store(0, std::memory_order_relaxed);
+            }
+        }
+        allocations.store(0, std::memory_order_relaxed);
+    }
+
+    void note_allocation() {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::string to_json(const Snapshot& s) {
+        auto u = [](uint64_t v) { return static_cast<unsigned long long>(v); };
+        char out[768];
+        std::snprintf(out, sizeof(out),
+                      "{\"enabled\":%s,\"bytes_hashed\":%llu,\"blocks_compressed\":%llu,"
+                      "\"blocks_by_backend\":{\"portable\":%llu,\"sha-ni\":%llu,\"avx2\":%llu,\"avx512\":%llu},"
+                      "\"chunks\":%llu,\"heap_allocations\":%llu,\"read_seconds\":%.6f,\"compute_seconds\":%.6f,"
+                      "\"sha1_backend\":\"%s\",\"sha1_batch_backend\":\"%s\",\"sha256_backend\":\"%s\"}",
+                      ENABLED ? "true" : "false", u(s[Counter::BytesHashed]), u(s.blocks()),
+                      u(s[Counter::BlocksPortable]), u(s[Counter::BlocksShaNi]), u(s[Counter::BlocksAvx2]),
+                      u(s[Counter::BlocksAvx512]), u(s[Counter::Chunks]), u(s.allocations),
+                      static_cast<double>(s[Counter::ReadNanos]) / 1e9,
+                      static_cast<double>(s[Counter::ComputeNanos]) / 1e9,
+                      std::string(sha1::backend_name(sha1::active_backend())).c_str(),
+                      std::string(sha1::backend_name(sha1::active_batch_backend())).c_str(),
+                      std::string(sha256::backend_name(sha256::active_backend())).c_str());
+        return out;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef STATS_COUNTERS_H
+#define STATS_COUNTERS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <hash/stats.h>
+
+// Counting side of hash/stats.h, for use inside boogielib only.
+namespace hash::stats {
+    // One thread's counters. Only the owning thread writes them, snapshot() reads them from anywhere.
+    struct Counters {
+        std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::Count)> values{};
+    };
+
+    // Null until the thread first counts something. constinit, or every reader calls a TLS init
+    // function first to find out that there is nothing to initialise.
+    extern constinit thread_local Counters* thread_counters;
+    Counters* attach_thread();
+
+    inline void add(Counter c, uint64_t n) {
+        if constexpr (ENABLED) {
+            Counters* counters = thread_counters ? thread_counters : attach_thread();
+            auto& slot = counters->values[static_cast<size_t>(c)];
+            // Single writer, so a load and a store do the job of a locked add.
+            slot.store(slot.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+    }
+
+    // Adds the lifetime of the scope to a time counter. Compiles to nothing when stats are off.
+    class Timer {
+    public:
+        explicit Timer(Counter c) : counter(c) {
+            if constexpr (ENABLED) {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~Timer() {
+            if constexpr (ENABLED) {
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                add(counter, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            }
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        Counter counter;
+        std::chrono::steady_clock::time_point start;
+    };
+}
+
+#endif // STATS_COUNTERS_H
@@ -1,28 +1,514 @@
+#include <charconv>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
 #include <iostream>
+#include <span>
 #include <string>
-#include <sstream>
+#include <string_view>
+#include <vector>
 
+#include <unistd.h>
+
+#include "hash/cdc.h"
+#include "hash/dedup.h"
+#include "hash/digest_cache.h"
+#include "hash/git.h"
 #include "hash/sha1.h"
+#include "hash/sha1_tree.h"
+#include "hash/sha256.h"
+#include "hash/stats.h"
+#include "util/counting_new.h"
+#include "util/file.h"
+#include "util/output.h"
+
+// Counts every heap allocation for --stats.
+void utils::on_allocation() noexcept {
+    hash::stats::note_allocation();
+}
+
+namespace {
+    void usage(const char* argv0) {
+        std::cerr << "Usage: " << argv0 << " <hash_function> [options] [FILE...]\n";
+        std::cerr << "       " << argv0 << " git-hash-object FILE...\n";
+        std::cerr << "       " << argv0 << " git-write-tree [-j N] [DIR]\n";
+        std::cerr << "       " << argv0 << " dedup [-j N] DIR...\n";
+        std::cerr << "  Available hash functions: sha1, sha256, sha1-tree, sha1-chunks\n";
+        std::cerr << "  With no FILE, or when FILE is -, read standard input.\n";
+        std::cerr << "  sha1-tree hashes each FILE as a Merkle tree of 1 MiB leaves on every core (not plain SHA-1)\n";
+        std::cerr << "  sha1-chunks cuts each FILE into content-defined chunks and prints DIGEST OFFSET LENGTH  FILE per chunk\n";
+        std::cerr << "  dedup lists files with identical content under the DIRs, one group per paragraph\n";
+        std::cerr << "  git-hash-object prints the git blob ID of each FILE, git-write-tree the tree ID of DIR (default .)\n";
+        std::cerr << "Options:\n";
+        std::cerr << "  -j N             hash up to N files at once (default: one per core)\n";
+        std::cerr << "  -c, --check      read sha1sum-style checksums from the FILEs and verify them (sha1 only)\n";
+        std::cerr << "  --cache FILE     digest cache to use (default: $BOOGIE_CACHE, else ~/.cache/boogie/sha1.idx)\n";
+        std::cerr << "  --no-cache       neither read nor update the digest cache\n";
+        std::cerr << "  --refresh        rehash every file and rewrite its cache entry\n";
+        std::cerr << "  --prune-cache    drop cache entries for files this run did not hash or find\n";
+        std::cerr << "  --min-size N, --avg-size N, --max-size N\n";
+        std::cerr << "                   sha1-chunks chunk sizes, K/M/G suffixes allowed (default: 16K, 64K, 256K)\n";
+        std::cerr << "  --stats          print a JSON summary of bytes, blocks, backends and I/O vs hashing time to stderr\n";
+    }
+
+    struct Options {
+        unsigned jobs = 0;
+        bool check = false;
+        bool no_cache = false;
+        bool refresh = false;
+        bool prune_cache = false;
+        bool stats = false;
+        std::string cache_path;
+        hash::cdc::Params chunk_sizes;
+        std::vector<std::string> files;
+    };
+
+    // The whole of `arg` as a decimal number that fits in T, or nothing.
+    template<typename T>
+    std::optional<T> parse_number(std::string_view arg) {
+        T value;
+        const auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+        if (error != std::errc() || end != arg.data() + arg.size()) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // Some commands start exactly -j threads, so a typo must not ask for billions of them.
+    constexpr unsigned MAX_JOBS = 1024;
+
+    // The N of -j N or -jN, 0 meaning one per core. Prints its own error.
+    bool parse_jobs(std::string_view arg, unsigned& jobs) {
+        const std::optional<unsigned> n = parse_number<unsigned>(arg);
+        if (!n || *n > MAX_JOBS) {
+            std::cerr << "Error: -j takes a number from 0 to " << MAX_JOBS << ", not '" << arg << "'\n";
+            return false;
+        }
+        jobs = *n;
+        return true;
+    }
+
+    // A byte count with an optional binary K, M or G suffix. Prints its own error.
+    bool parse_size(std::string_view option, std::string_view arg, size_t& size) {
+        const size_t digits = arg.find_first_not_of("0123456789");
+        const std::string_view suffix = digits == std::string_view::npos ? "" : arg.substr(digits);
+        const int shift = suffix.empty() ? 0 : suffix == "K" ? 10 : suffix == "M" ? 20 : suffix == "G" ? 30 : -1;
+        const std::optional<size_t> value = parse_number<size_t>(arg.substr(0, arg.size() - suffix.size()));
+        if (shift < 0 || !value || *value > (SIZE_MAX >> shift)) {
+            std::cerr << "Error: " << option << " takes a byte count like 4096 or 64K, not '" << arg << "'\n";
+            return false;
+        }
+        size = *value << shift;
+        return true;
+    }
+
+    // Returns false on a malformed command line.
+    bool parse_options(std::span<char*> args, Options& opts) {
+        for (size_t i = 0; i < args.size(); i++) {
+            std::string_view arg = args[i];
+            if (arg == "-c" || arg == "--check") {
+                opts.check = true;
+            } else if (arg == "--no-cache") {
+                opts.no_cache = true;
+            } else if (arg == "--refresh") {
+                opts.refresh = true;
+            } else if (arg == "--prune-cache") {
+                opts.prune_cache = true;
+            } else if (arg == "--stats") {
+                opts.stats = true;
+            } else if (arg == "--min-size" && i + 1 < args.size()) {
+                if (!parse_size(arg, args[++i], opts.chunk_sizes.min_size)) {
+                    return false;
+                }
+            } else if (arg == "--avg-size" && i + 1 < args.size()) {
+                if (!parse_size(arg, args[++i], opts.chunk_sizes.avg_size)) {
+                    return false;
+                }
+            } else if (arg == "--max-size" && i + 1 < args.size()) {
+                if (!parse_size(arg, args[++i], opts.chunk_sizes.max_size)) {
+                    return false;
+                }
+            } else if (arg == "--cache" && i + 1 < args.size()) {
+                opts.cache_path = args[++i];
+            } else if (arg.starts_with("-j") && arg.size() > 2) {
+                if (!parse_jobs(arg.substr(2), opts.jobs)) {
+                    return false;
+                }
+            } else if (arg == "-j" && i + 1 < args.size()) {
+                if (!parse_jobs(args[++i], opts.jobs)) {
+                    return false;
+                }
+            } else if (arg == "--") {
+                opts.files.insert(opts.files.end(), args.begin() + i + 1, args.end());
+                break;
+            } else if (arg.starts_with("-") && arg != "-") {
+                std::cerr << "Error: Unknown option '" << arg << "'\n";
+                return false;
+            } else {
+                opts.files.emplace_back(arg);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * sha1sum escapes names holding a backslash or newline and flags the line with a leading
+     * backslash, so every checksum stays on one line.
+     */
+    std::string escape_name(const std::string& name, bool& escaped) {
+        escaped = name.find_first_of("\\\n") != std::string::npos;
+        if (!escaped) {
+            return name;
+        }
+        std::string out;
+        for (char c : name) {
+            if (c == '\\') {
+                out += "\\\\";
+            } else if (c == '\n') {
+                out += "\\n";
+            } else {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    std::string unescape_name(std::string_view name) {
+        std::string out;
+        for (size_t i = 0; i < name.size(); i++) {
+            if (name[i] == '\\' && i + 1 < name.size()) {
+                out += name[++i] == 'n' ? '\n' : name[i];
+            } else {
+                out += name[i];
+            }
+        }
+        return out;
+    }
+
+    std::string default_cache_path() {
+        if (const char* path = std::getenv("BOOGIE_CACHE")) {
+            return path;
+        }
+        if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+            return std::string(xdg) + "/boogie/sha1.idx";
+        }
+        if (const char* home = std::getenv("HOME"); home && *home) {
+            return std::string(home) + "/.cache/boogie/sha1.idx";
+        }
+        return "";
+    }
+
+    // The digest cache the options ask for, or null when caching is off or has nowhere to live.
+    std::unique_ptr<hash::sha1::DigestCache> open_cache(const Options& opts) {
+        std::string path = opts.cache_path.empty() ? default_cache_path() : opts.cache_path;
+        if (opts.no_cache || path.empty()) {
+            return nullptr;
+        }
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+        auto cache = std::make_unique<hash::sha1::DigestCache>(path);
+        cache->set_refresh(opts.refresh);
+        cache->set_prune(opts.prune_cache);
+        return cache;
+    }
+
+    // A cache that cannot be written only costs the next run time, so it is a warning, not a failure.
+    void commit_cache(hash::sha1::DigestCache* cache) {
+        if (cache == nullptr) {
+            return;
+        }
+        try {
+            cache->commit();
+        } catch (const std::exception& e) {
+            std::cerr << "boogie: WARNING: digest cache not updated: " << e.what() << "\n";
+        }
+    }
+
+    int sha1_files(const Options& opts, utils::OutputWriter& out) {
+        int status = 0;
+        auto cache = open_cache(opts);
+        hash::sha1::hash_files(opts.files, opts.jobs, [&](size_t i, const hash::sha1::FileResult& result) {
+            if (!result.ok()) {
+                std::cerr << "boogie: " << result.error << "\n";
+                status = 1;
+                return;
+            }
+            bool escaped;
+            std::string name = escape_name(opts.files[i], escaped);
+            out.write(escaped ? "\\" : "").hex(hash::sha1::to_digest(result.raw_hash)).write("  ").write(name).end_line();
+        }, cache.get());
+        commit_cache(cache.get());
+        return status;
+    }
+
+    // Parses "<40 hex digits>  <name>" (or " *<name>" for binary mode). Returns false if malformed.
+    bool parse_check_line(std::string_view line, hash::sha1::Digest& expected, std::string& name) {
+        bool escaped = line.starts_with('\\');
+        if (escaped) {
+            line.remove_prefix(1);
+        }
+        constexpr size_t hex_len = hash::sha1::HEX_LEN;
+        if (line.size() < hex_len + 3 || line[hex_len] != ' ' || (line[hex_len + 1] != ' ' && line[hex_len + 1] != '*')) {
+            return false;
+        }
+        if (!hash::hex::decode(line.substr(0, hex_len), expected)) {
+            return false;
+        }
+        std::string_view raw_name = line.substr(hex_len + 2);
+        name = escaped ? unescape_name(raw_name) : std::string(raw_name);
+        return true;
+    }
+
+    int sha1_check(const Options& opts, utils::OutputWriter& out) {
+        std::vector<hash::sha1::Digest> expected;
+        std::vector<std::string> names;
+        size_t malformed = 0;
+
+        for (const auto& manifest : opts.files) {
+            std::ifstream file;
+            if (manifest != "-") {
+                file.open(manifest);
+                if (!file) {
+                    std::cerr << "boogie: " << manifest << ": cannot open checksum file\n";
+                    return 1;
+                }
+            }
+            std::istream& in = manifest == "-" ? std::cin : file;
+            std::string line, name;
+            hash::sha1::Digest digest;
+            while (std::getline(in, line)) {
+                if (parse_check_line(line, digest, name)) {
+                    expected.push_back(digest);
+                    names.push_back(name);
+                } else if (!line.empty()) {
+                    malformed++;
+                }
+            }
+        }
+
+        size_t mismatched = 0;
+        size_t unreadable = 0;
+        auto cache = open_cache(opts);
+        hash::sha1::hash_files(names, opts.jobs, [&](size_t i, const hash::sha1::FileResult& result) {
+            if (!result.ok()) {
+                std::cerr << "boogie: " << result.error << "\n";
+                out.write(names[i]).write(": FAILED open or read").end_line();
+                unreadable++;
+            } else if (hash::sha1::to_digest(result.raw_hash) != expected[i]) {
+                out.write(names[i]).write(": FAILED").end_line();
+                mismatched++;
+            } else {
+                out.write(names[i]).write(": OK").end_line();
+            }
+        }, cache.get());
+        commit_cache(cache.get());
+
+        if (malformed > 0) {
+            std::cerr << "boogie: WARNING: " << malformed << " line" << (malformed == 1 ? " is" : "s are")
+                      << " improperly formatted\n";
+        }
+        if (unreadable > 0) {
+            std::cerr << "boogie: WARNING: " << unreadable << " listed file" << (unreadable == 1 ? "" : "s")
+                      << " could not be read\n";
+        }
+        if (mismatched > 0) {
+            std::cerr << "boogie: WARNING: " << mismatched << " computed checksum" << (mismatched == 1 ? "" : "s")
+                      << " did NOT match\n";
+        }
+        if (names.empty()) {
+            std::cerr << "boogie: no properly formatted checksum lines found\n";
+            return 1;
+        }
+        return mismatched + unreadable > 0 ? 1 : 0;
+    }
+
+    // sha256sum-style output. Files go one after the other; none of the SHA-1 cache or batching applies.
+    int run_sha256(const Options& opts, utils::OutputWriter& out) {
+        if (opts.check) {
+            return -1;
+        }
+        std::vector<std::string> files = opts.files.empty() ? std::vector<std::string>{"-"} : opts.files;
+        int status = 0;
+        for (const auto& path : files) {
+            try {
+                const hash::sha256::Digest digest = path == "-"
+                    ? hash::sha256::hash_fd_raw(STDIN_FILENO, "-")
+                    : hash::sha256::hash_fd_raw(utils::File(path).fd(), path);
+                bool escaped;
+                std::string name = escape_name(path, escaped);
+                out.write(escaped ? "\\" : "").hex(digest).write("  ").write(name).end_line();
+            } catch (const std::exception& e) {
+                std::cerr << "boogie: " << e.what() << "\n";
+                status = 1;
+            }
+        }
+        return status;
+    }
+
+    int run_sha1_tree(const Options& opts, utils::OutputWriter& out) {
+        if (opts.check) {
+            return -1;
+        }
+        // One file at a time, each spread over all the workers.
+        std::vector<std::string> files = opts.files.empty() ? std::vector<std::string>{"-"} : opts.files;
+        int status = 0;
+        for (const auto& path : files) {
+            try {
+                const hash::sha1::Digest root = hash::sha1::tree::hash_file_tree(path, opts.jobs).root;
+                bool escaped;
+                std::string name = escape_name(path, escaped);
+                out.write(escaped ? "\\" : "").hex(root).write("  ").write(name).end_line();
+            } catch (const std::exception& e) {
+                std::cerr << "boogie: " << e.what() << "\n";
+                status = 1;
+            }
+        }
+        return status;
+    }
+
+    int run_sha1_chunks(const Options& opts, utils::OutputWriter& out) {
+        if (opts.check) {
+            return -1;
+        }
+        opts.chunk_sizes.validate();
+        std::vector<std::string> files = opts.files.empty() ? std::vector<std::string>{"-"} : opts.files;
+        int status = 0;
+        for (const auto& path : files) {
+            bool escaped;
+            const std::string name = escape_name(path, escaped);
+            try {
+                hash::cdc::chunk_file(path, [&](const hash::cdc::Chunk& chunk) {
+                    out.write(escaped ? "\\" : "").hex(chunk.digest).put(' ').number(chunk.offset).put(' ')
+                        .number(chunk.length).write("  ").write(name).end_line();
+                }, opts.chunk_sizes, opts.jobs);
+            } catch (const std::exception& e) {
+                std::cerr << "boogie: " << e.what() << "\n";
+                status = 1;
+            }
+        }
+        return status;
+    }
+
+    int run_dedup(const Options& opts, utils::OutputWriter& out) {
+        if (opts.check || opts.files.empty()) {
+            return -1;
+        }
+        hash::dedup::Options dedup_opts;
+        dedup_opts.threads = opts.jobs;
+        const hash::dedup::Report report = hash::dedup::find_duplicates(opts.files, dedup_opts);
+        for (size_t g = 0; g < report.groups.size(); g++) {
+            const auto& group = report.groups[g];
+            if (g > 0) {
+                out.end_line();
+            }
+            for (const auto& path : group.paths) {
+                bool escaped;
+                std::string name = escape_name(path, escaped);
+                out.write(escaped ? "\\" : "").hex(group.digest).write("  ").write(name).end_line();
+            }
+        }
+        for (const auto& error : report.errors) {
+            std::cerr << "boogie: " << error << "\n";
+        }
+        std::cerr << "boogie: " << report.groups.size() << " groups of duplicates, " << report.reclaimable()
+                  << " bytes reclaimable; read " << report.bytes_read << " of " << report.bytes_total << " bytes in "
+                  << report.files << " files\n";
+        return report.errors.empty() ? 0 : 1;
+    }
+
+    int run_git_hash_object(const Options& opts, utils::OutputWriter& out) {
+        if (opts.check || opts.files.empty()) {
+            return -1;
+        }
+        int status = 0;
+        for (const auto& path : opts.files) {
+            try {
+                out.hex(hash::git::hash_blob_file(path)).end_line();
+            } catch (const std::exception& e) {
+                std::cerr << "boogie: " << e.what() << "\n";
+                status = 1;
+            }
+        }
+        return status;
+    }
+
+    int run_git_write_tree(const Options& opts, utils::OutputWriter& out) {
+        if (opts.check || opts.files.size() > 1) {
+            return -1;
+        }
+        const std::string dir = opts.files.empty() ? "." : opts.files[0];
+        out.hex(hash::git::write_tree(dir, opts.jobs)).end_line();
+        return 0;
+    }
+
+    int run_sha1(const Options& opts, utils::OutputWriter& out) {
+        if (opts.check) {
+            Options check_opts = opts;
+            if (check_opts.files.empty()) {
+                check_opts.files.push_back("-");
+            }
+            return sha1_check(check_opts, out);
+        }
+        if (opts.files.empty()) {
+            // Stream stdin straight into the hasher so memory use does not grow with the input.
+            out.hex(hash::sha1::to_digest(hash::sha1::hash_fd_raw(STDIN_FILENO, "-"))).end_line();
+            return 0;
+        }
+        return sha1_files(opts, out);
+    }
+}
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <hash_function>\n";
-        std::cerr << "  Available hash functions: sha1\n";
+    if (argc < 2) {
+        usage(argv[0]);
         return 1;
     }
 
     std::string hash_function = argv[1];
-    std::string input;
-    std::stringstream buffer;
 
-    // Read from stdin
-    buffer << std::cin.rdbuf();
-    input = buffer.str();
+    try {
+        Options opts;
+        if (!parse_options(std::span(argv + 2, argc - 2), opts)) {
+            usage(argv[0]);
+            return 1;
+        }
 
-    if (hash_function == "sha1") {
-        std::cout << hash::sha1::hash_string(input) << std::endl;
-    } else {
-        std::cerr << "Error: Unknown hash function '" << hash_function << "'\n";
+        utils::OutputWriter out(STDOUT_FILENO);
+        int status;
+        if (hash_function == "sha1") {
+            status = run_sha1(opts, out);
+        } else if (hash_function == "sha256") {
+            status = run_sha256(opts, out);
+        } else if (hash_function == "sha1-tree") {
+            status = run_sha1_tree(opts, out);
+        } else if (hash_function == "sha1-chunks") {
+            status = run_sha1_chunks(opts, out);
+        } else if (hash_function == "dedup") {
+            status = run_dedup(opts, out);
+        } else if (hash_function == "git-hash-object") {
+            status = run_git_hash_object(opts, out);
+        } else if (hash_function == "git-write-tree") {
+            status = run_git_write_tree(opts, out);
+        } else {
+            std::cerr << "Error: Unknown hash function '" << hash_function << "'\n";
+            return 1;
+        }
+        if (status < 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        out.flush();
+        if (opts.stats) {
+            if (!hash::stats::ENABLED) {
+                std::cerr << "boogie: WARNING: built without BOOGIE_STATS, every counter is zero\n";
+            }
+            std::cerr << hash::stats::to_json(hash::stats::snapshot()) << "\n";
+        }
+        return status;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
         return 1;
     }
 
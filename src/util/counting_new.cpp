@@ -0,0 +1,30 @@
+#include <cstdlib>
+#include <new>
+
+#include "counting_new.h"
+
+void* operator new(size_t size) {
+    utils::on_allocation();
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// The standard library (std::stable_sort's scratch buffer, for one) also allocates through the nothrow forms.
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    utils::on_allocation();
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,14 @@
+#ifndef COUNTING_NEW_H
+#define COUNTING_NEW_H
+
+/**
+ * counting_new.cpp replaces the global operator new and delete with versions that call
+ * on_allocation() before every allocation. Programs that count their allocations (the CLI
+ * for --stats, the benchmark, the tests) compile it in and define on_allocation() themselves.
+ * The library never links it.
+ */
+namespace utils {
+    void on_allocation() noexcept;
+}
+
+#endif // COUNTING_NEW_H
@@ -0,0 +1,67 @@
+#include <util/cpu.h>
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace utils::cpu {
+#if defined(__x86_64__) || defined(__i386__)
+    namespace {
+        struct Features {
+            bool sha_ni = false;
+            bool avx2 = false;
+            bool avx512 = false;
+        };
+
+        // XCR0 tells us which register files the OS saves on a context switch.
+        // A CPU can advertise AVX while the kernel refuses to preserve the ymm/zmm state.
+        uint64_t xgetbv0() {
+            uint32_t eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (static_cast<uint64_t>(edx) << 32) | eax;
+        }
+
+        Features detect() {
+            Features features;
+            unsigned int eax, ebx, ecx, edx;
+            if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+                return features;
+            }
+            const bool ssse3 = ecx & (1u << 9);
+            const bool sse41 = ecx & (1u << 19);
+            const bool osxsave = ecx & (1u << 27);
+            const bool avx = ecx & (1u << 28);
+
+            if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+                return features;
+            }
+            features.sha_ni = ssse3 && sse41 && (ebx & (1u << 29));
+
+            if (!osxsave || !avx) {
+                return features;
+            }
+            const uint64_t xcr0 = xgetbv0();
+            const bool ymm_state = (xcr0 & 0x6) == 0x6;   // SSE and AVX state
+            const bool zmm_state = (xcr0 & 0xE6) == 0xE6; // ... plus opmask and both zmm halves
+            features.avx2 = ymm_state && (ebx & (1u << 5));
+            features.avx512 = zmm_state && (ebx & (1u << 16)); // AVX-512F
+            return features;
+        }
+
+        const Features& features() {
+            static const Features f = detect();
+            return f;
+        }
+    }
+
+    bool has_sha_ni() { return features().sha_ni; }
+    bool has_avx2() { return features().avx2; }
+    bool has_avx512() { return features().avx512; }
+#else
+    bool has_sha_ni() { return false; }
+    bool has_avx2() { return false; }
+    bool has_avx512() { return false; }
+#endif
+}
@@ -0,0 +1,17 @@
+#ifndef CPU_H
+#define CPU_H
+
+// Set where the x86 kernels (sha1_shani.cpp and friends) are built. Anything that names one of them
+// must sit behind it, or non-x86 builds fail to link.
+#if defined(__x86_64__) || defined(__i386__)
+#define BOOGIE_X86_KERNELS 1
+#endif
+
+namespace utils::cpu {
+    // Runtime CPU feature queries. All of these return false on non-x86 targets.
+    bool has_sha_ni();
+    bool has_avx2();
+    bool has_avx512();
+}
+
+#endif // CPU_H
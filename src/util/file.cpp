@@ -0,0 +1,168 @@
+#include <util/file.h>
+#include <util/overlapped.h>
+
+#include <hash/stats_counters.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace utils {
+    namespace {
+        std::runtime_error io_error(const std::string& what, const std::string& name) {
+            return std::runtime_error(what + " " + name + ": " + std::strerror(errno));
+        }
+
+        // Returns false if the kernel would not map the file, leaving the caller to read() it instead.
+        bool map_all(int fd, size_t size, const ByteSink& sink, const std::string& name) {
+            for (size_t offset = 0; offset < size; offset += MAP_WINDOW) {
+                size_t len = std::min(MAP_WINDOW, size - offset);
+                void* addr;
+                {
+                    hash::stats::Timer timer(hash::stats::Counter::ReadNanos);
+                    addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(offset));
+                    if (addr == MAP_FAILED) {
+                        if (offset == 0) {
+                            return false;
+                        }
+                        throw io_error("Failed to map offset " + std::to_string(offset) + " of", name);
+                    }
+                    // Start pulling the whole window in now and let the kernel drop pages behind us.
+                    madvise(addr, len, MADV_SEQUENTIAL);
+                    madvise(addr, len, MADV_WILLNEED);
+                }
+
+                struct Unmap {
+                    void* addr;
+                    size_t len;
+                    ~Unmap() { munmap(addr, len); }
+                } unmap{addr, len};
+                feed(sink, std::span(static_cast<const std::byte*>(addr), len));
+            }
+            return true;
+        }
+
+        void read_loop(int fd, const ByteSink& sink, const std::string& name) {
+            auto buffer = std::make_unique_for_overwrite<std::byte[]>(READ_BUFFER_SIZE);
+            while (true) {
+                ssize_t n;
+                {
+                    hash::stats::Timer timer(hash::stats::Counter::ReadNanos);
+                    n = read(fd, buffer.get(), READ_BUFFER_SIZE);
+                }
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw io_error("Failed to read", name);
+                }
+                if (n == 0) {
+                    return;
+                }
+                feed(sink, std::span(buffer.get(), static_cast<size_t>(n)));
+            }
+        }
+    }
+
+    namespace {
+        ReadMethod detect_read_method() {
+            // BOOGIE_READ_METHOD=map brings back plain mmap, e.g. to compare against it.
+            if (const char* forced = std::getenv("BOOGIE_READ_METHOD")) {
+                for (ReadMethod m : {ReadMethod::Map, ReadMethod::Uring, ReadMethod::Thread}) {
+                    if (read_method_name(m) == forced && read_method_supported(m)) {
+                        return m;
+                    }
+                }
+            }
+            return uring_supported() ? ReadMethod::Uring : ReadMethod::Thread;
+        }
+
+        std::atomic<ReadMethod>& selected_read_method() {
+            static std::atomic<ReadMethod> selected{detect_read_method()};
+            return selected;
+        }
+    }
+
+    bool read_method_supported(ReadMethod m) {
+        switch (m) {
+            case ReadMethod::Map:
+            case ReadMethod::Thread:
+                return true;
+            case ReadMethod::Uring:
+                return uring_supported();
+        }
+        return false;
+    }
+
+    std::string_view read_method_name(ReadMethod m) {
+        switch (m) {
+            case ReadMethod::Map:
+                return "map";
+            case ReadMethod::Uring:
+                return "uring";
+            case ReadMethod::Thread:
+                return "thread";
+        }
+        return "unknown";
+    }
+
+    ReadMethod active_read_method() {
+        return selected_read_method().load(std::memory_order_relaxed);
+    }
+
+    bool set_read_method(ReadMethod m) {
+        if (!read_method_supported(m)) {
+            return false;
+        }
+        selected_read_method().store(m, std::memory_order_relaxed);
+        return true;
+    }
+
+    File::File(const std::string& path) : fd_(open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+        if (fd_ < 0) {
+            throw io_error("Failed to open file:", path);
+        }
+    }
+
+    File::~File() {
+        close(fd_);
+    }
+
+    void read_all(int fd, const ByteSink& sink, const std::string& name) {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            throw io_error("Failed to stat", name);
+        }
+
+        // Only map from the start of the file. Anything else (a shared stdin that was
+        // already read from, /proc files that report a size of 0) takes the read() path.
+        if (S_ISREG(st.st_mode) && st.st_size > 0 && lseek(fd, 0, SEEK_CUR) == 0) {
+            const auto size = static_cast<uint64_t>(st.st_size);
+            // With fewer than two buffers' worth there is nothing to overlap.
+            const ReadMethod method = size < 2 * ASYNC_BUFFER_SIZE ? ReadMethod::Map : active_read_method();
+            if (method == ReadMethod::Uring && read_uring(fd, size, sink, name)) {
+                return;
+            }
+            if (method != ReadMethod::Map) {
+                read_threaded(fd, size, sink, name);
+                return;
+            }
+            if (map_all(fd, static_cast<size_t>(size), sink, name)) {
+                return;
+            }
+        }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        read_loop(fd, sink, name);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef FILE_H
+#define FILE_H
+
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace utils {
+    // Regular files are mapped and hashed this many bytes at a time, so RSS stays flat however big they are.
+    constexpr size_t MAP_WINDOW = 64 * 1024 * 1024;
+    // Buffer size for pipes, sockets and anything else that cannot be mapped.
+    constexpr size_t READ_BUFFER_SIZE = 1024 * 1024;
+    // Overlapped reads keep this many buffers of this size in flight.
+    constexpr size_t ASYNC_BUFFER_SIZE = 2 * 1024 * 1024;
+    constexpr size_t ASYNC_DEPTH = 8;
+
+    // How read_all() reads regular files. Pipes and other unmappable files always use read().
+    enum class ReadMethod {
+        Map,    // mmap() a window at a time: no copies, readahead is up to the kernel
+        Uring,  // io_uring keeps ASYNC_DEPTH reads in flight while earlier buffers are consumed
+        Thread, // A reader thread keeps a ring of ASYNC_DEPTH buffers full with pread()
+    };
+
+    /**
+     * Uring is picked on first use where the kernel allows it, otherwise Thread. Setting
+     * BOOGIE_READ_METHOD to a read_method_name() overrides that choice for the whole process.
+     */
+    ReadMethod active_read_method();
+    bool read_method_supported(ReadMethod m);
+    // Returns false (and changes nothing) if `m` cannot be used here.
+    bool set_read_method(ReadMethod m);
+    std::string_view read_method_name(ReadMethod m);
+
+    // Owns a file descriptor and closes it on destruction.
+    class File {
+    public:
+        // Opens `path` read-only. Throws std::runtime_error on failure.
+        explicit File(const std::string& path);
+        ~File();
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+
+        int fd() const { return fd_; }
+
+    private:
+        int fd_;
+    };
+
+    using ByteSink = std::function<void(std::span<const std::byte>)>;
+
+    /**
+     * Feeds everything readable from `fd` to `sink`, in order.
+     * Regular files are read with the active ReadMethod, so the disk keeps working while `sink`
+     * does; files too small to have anything to overlap are mapped in one go.
+     * Pipes, terminals and files that refuse to be mapped go through read() into one large buffer.
+     * `name` only shows up in error messages. Throws std::runtime_error on I/O errors.
+     */
+    void read_all(int fd, const ByteSink& sink, const std::string& name);
+}
+
+#endif // FILE_H
@@ -0,0 +1,89 @@
+#include <util/output.h>
+
+#include <hash/hex.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <unistd.h>
+
+namespace utils {
+    OutputWriter::OutputWriter(int fd)
+        : fd(fd), line_buffered(isatty(fd) == 1),
+          buffer(std::make_unique_for_overwrite<char[]>(OUTPUT_BUFFER_SIZE)) {}
+
+    OutputWriter::~OutputWriter() {
+        try {
+            flush();
+        } catch (...) {
+            // Nowhere left to report it.
+        }
+    }
+
+    char* OutputWriter::reserve(size_t n) {
+        if (OUTPUT_BUFFER_SIZE - used < n) {
+            flush();
+        }
+        return buffer.get() + used;
+    }
+
+    OutputWriter& OutputWriter::write(std::string_view s) {
+        while (!s.empty()) {
+            const size_t n = std::min(s.size(), OUTPUT_BUFFER_SIZE);
+            std::memcpy(reserve(n), s.data(), n);
+            used += n;
+            s.remove_prefix(n);
+        }
+        return *this;
+    }
+
+    OutputWriter& OutputWriter::put(char c) {
+        *reserve(1) = c;
+        used++;
+        return *this;
+    }
+
+    OutputWriter& OutputWriter::number(uint64_t n) {
+        constexpr size_t max_digits = 20;
+        char* out = reserve(max_digits);
+        used = static_cast<size_t>(std::to_chars(out, out + max_digits, n).ptr - buffer.get());
+        return *this;
+    }
+
+    OutputWriter& OutputWriter::hex(std::span<const std::byte> bytes) {
+        while (!bytes.empty()) {
+            const size_t n = std::min(bytes.size(), OUTPUT_BUFFER_SIZE / 2);
+            used = static_cast<size_t>(hash::hex::encode(bytes.first(n), reserve(2 * n)) - buffer.get());
+            bytes = bytes.subspan(n);
+        }
+        return *this;
+    }
+
+    OutputWriter& OutputWriter::end_line() {
+        put('\n');
+        if (line_buffered) {
+            flush();
+        }
+        return *this;
+    }
+
+    void OutputWriter::flush() {
+        size_t done = 0;
+        while (done < used) {
+            const ssize_t n = ::write(fd, buffer.get() + done, used - done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                used = 0; // Drop it rather than fail again from the destructor
+                throw std::runtime_error(std::string("Failed to write output: ") + std::strerror(errno));
+            }
+            done += static_cast<size_t>(n);
+        }
+        used = 0;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace utils {
+    constexpr size_t OUTPUT_BUFFER_SIZE = 64 * 1024;
+
+    /**
+     * Buffered writer for bulk line output, such as millions of manifest lines. Everything is
+     * formatted straight into one buffer that goes out in a single write() when it fills up,
+     * so a line costs no allocation and no stream machinery.
+     * When `fd` is a terminal each end_line() flushes, so interactive output is not held back.
+     * Not thread-safe. flush() throws std::runtime_error on a write error; the destructor
+     * flushes and ignores errors.
+     */
+    class OutputWriter {
+    public:
+        explicit OutputWriter(int fd);
+        ~OutputWriter();
+        OutputWriter(const OutputWriter&) = delete;
+        OutputWriter& operator=(const OutputWriter&) = delete;
+
+        OutputWriter& write(std::string_view s);
+        OutputWriter& put(char c);
+        // Decimal
+        OutputWriter& number(uint64_t n);
+        // Lowercase hex, two digits per byte
+        OutputWriter& hex(std::span<const std::byte> bytes);
+        // Writes '\n' and, on a terminal, flushes.
+        OutputWriter& end_line();
+        void flush();
+
+    private:
+        // Makes room for `n` more bytes, n <= OUTPUT_BUFFER_SIZE.
+        char* reserve(size_t n);
+
+        int fd;
+        bool line_buffered;
+        std::unique_ptr<char[]> buffer;
+        size_t used = 0;
+    };
+}
+
+#endif // OUTPUT_H
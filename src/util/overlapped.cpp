@@ -0,0 +1,365 @@
+#include <util/overlapped.h>
+
+#include <hash/stats_counters.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define BOOGIE_HAVE_URING 1
+#endif
+#endif
+
+namespace utils {
+    namespace {
+        std::runtime_error io_error(const std::string& what, const std::string& name) {
+            return std::runtime_error(what + " " + name + ": " + std::strerror(errno));
+        }
+
+        std::runtime_error shrank(const std::string& name) {
+            return std::runtime_error(name + " shrank while it was being read");
+        }
+
+        struct Buffer {
+            std::unique_ptr<std::byte[]> data = std::make_unique_for_overwrite<std::byte[]>(ASYNC_BUFFER_SIZE);
+            uint64_t offset = 0; // In the file
+            size_t len = 0;      // Bytes this buffer is to hold
+            size_t filled = 0;   // Bytes read so far
+            iovec iov{};         // What is in flight; must stay put until the read completes
+        };
+
+        size_t depth_for(uint64_t size) {
+            return static_cast<size_t>(std::min<uint64_t>(ASYNC_DEPTH, (size + ASYNC_BUFFER_SIZE - 1) / ASYNC_BUFFER_SIZE));
+        }
+
+#ifdef BOOGIE_HAVE_URING
+        /**
+         * The bare minimum of io_uring over raw syscalls: a submission and a completion ring
+         * mapped from the kernel, one producer and one consumer (this thread) on each.
+         */
+        class Ring {
+        public:
+            explicit Ring(unsigned entries) {
+                io_uring_params params{};
+                fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+                if (fd < 0) {
+                    return;
+                }
+                sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+                if (single) {
+                    sq_size = cq_size = std::max(sq_size, cq_size);
+                }
+                sq_map = map(sq_size, IORING_OFF_SQ_RING);
+                cq_map = single ? sq_map : map(cq_size, IORING_OFF_CQ_RING);
+                sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+                sqes = static_cast<io_uring_sqe*>(map(sqes_size, IORING_OFF_SQES));
+                if (sq_map == MAP_FAILED || cq_map == MAP_FAILED || sqes == MAP_FAILED) {
+                    return;
+                }
+                auto* sq = static_cast<std::byte*>(sq_map);
+                auto* cq = static_cast<std::byte*>(cq_map);
+                sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+                sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+                sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+                cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+                cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+                cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+                cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+                ready = true;
+            }
+
+            ~Ring() {
+                if (sqes && sqes != MAP_FAILED) {
+                    munmap(sqes, sqes_size);
+                }
+                if (cq_map && cq_map != MAP_FAILED && cq_map != sq_map) {
+                    munmap(cq_map, cq_size);
+                }
+                if (sq_map && sq_map != MAP_FAILED) {
+                    munmap(sq_map, sq_size);
+                }
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+
+            Ring(const Ring&) = delete;
+            Ring& operator=(const Ring&) = delete;
+
+            bool ok() const { return ready; }
+
+            // Queues a read into `buf.iov`; it is sent to the kernel by the next enter().
+            void push_read(int file, Buffer& buf, uint64_t tag) {
+                buf.iov = iovec{buf.data.get() + buf.filled, buf.len - buf.filled};
+                const unsigned tail = *sq_tail;
+                const unsigned index = tail & sq_mask;
+                io_uring_sqe& sqe = sqes[index];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode = IORING_OP_READV; // READV rather than READ: every io_uring kernel has it
+                sqe.fd = file;
+                sqe.addr = reinterpret_cast<uint64_t>(&buf.iov);
+                sqe.len = 1;
+                sqe.off = buf.offset + buf.filled;
+                sqe.user_data = tag;
+                sq_array[index] = index;
+                std::atomic_ref(*sq_tail).store(tail + 1, std::memory_order_release);
+                unsubmitted++;
+            }
+
+            // Sends queued reads and, with `wait`, blocks until at least that many have completed.
+            void enter(unsigned wait) {
+                while (unsubmitted > 0 || wait > 0) {
+                    const long n = syscall(__NR_io_uring_enter, fd, unsubmitted, wait, wait ? IORING_ENTER_GETEVENTS : 0,
+                                           nullptr, 0);
+                    if (n < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+                    }
+                    unsubmitted -= static_cast<unsigned>(n);
+                    return;
+                }
+            }
+
+            bool pop(io_uring_cqe& out) {
+                const unsigned head = *cq_head;
+                if (head == std::atomic_ref(*cq_tail).load(std::memory_order_acquire)) {
+                    return false;
+                }
+                out = cqes[head & cq_mask];
+                std::atomic_ref(*cq_head).store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+        private:
+            void* map(size_t len, off_t what) {
+                return mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, what);
+            }
+
+            int fd = -1;
+            bool ready = false;
+            unsigned unsubmitted = 0;
+            size_t sq_size = 0;
+            size_t cq_size = 0;
+            size_t sqes_size = 0;
+            void* sq_map = nullptr;
+            void* cq_map = nullptr;
+            io_uring_sqe* sqes = nullptr;
+            unsigned* sq_tail = nullptr;
+            unsigned sq_mask = 0;
+            unsigned* sq_array = nullptr;
+            unsigned* cq_head = nullptr;
+            unsigned* cq_tail = nullptr;
+            unsigned cq_mask = 0;
+            io_uring_cqe* cqes = nullptr;
+        };
+#endif
+    }
+
+    void feed(const ByteSink& sink, std::span<const std::byte> data) {
+        hash::stats::add(hash::stats::Counter::Chunks, 1);
+        hash::stats::Timer timer(hash::stats::Counter::ComputeNanos);
+        sink(data);
+    }
+
+#ifdef BOOGIE_HAVE_URING
+    bool uring_supported() {
+        static const bool supported = Ring(1).ok();
+        return supported;
+    }
+
+    bool read_uring(int fd, uint64_t size, const ByteSink& sink, const std::string& name) {
+        const size_t depth = depth_for(size);
+        Ring ring(static_cast<unsigned>(depth));
+        if (!ring.ok()) {
+            return false;
+        }
+        std::vector<Buffer> buffers(depth);
+        size_t in_flight = 0;
+
+        // The kernel writes into `buffers` until each read completes, so never leave before it has.
+        struct Drain {
+            Ring& ring;
+            size_t& in_flight;
+            ~Drain() {
+                try {
+                    io_uring_cqe cqe;
+                    while (in_flight > 0) {
+                        ring.enter(1);
+                        while (ring.pop(cqe)) {
+                            in_flight--;
+                        }
+                    }
+                } catch (...) {
+                    // Nothing sensible left to do; the ring is torn down next.
+                }
+            }
+        } drain{ring, in_flight};
+
+        uint64_t next = 0; // File offset of the next buffer to start
+        auto start = [&](size_t slot) {
+            Buffer& buf = buffers[slot];
+            buf.offset = next;
+            buf.len = static_cast<size_t>(std::min<uint64_t>(ASYNC_BUFFER_SIZE, size - next));
+            buf.filled = 0;
+            next += buf.len;
+            ring.push_read(fd, buf, slot);
+            in_flight++;
+        };
+        for (size_t slot = 0; slot < depth; slot++) {
+            start(slot);
+        }
+        ring.enter(0);
+
+        // Buffer k holds parts k, k + depth, k + 2 * depth... so taking them round-robin keeps file order.
+        for (uint64_t part = 0; part * ASYNC_BUFFER_SIZE < size; part++) {
+            const size_t slot = part % depth;
+            Buffer& buf = buffers[slot];
+            {
+                hash::stats::Timer timer(hash::stats::Counter::ReadNanos);
+                while (buf.filled < buf.len) {
+                    ring.enter(1);
+                    io_uring_cqe cqe;
+                    while (ring.pop(cqe)) {
+                        in_flight--;
+                        Buffer& done = buffers[cqe.user_data];
+                        if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                            ring.push_read(fd, done, cqe.user_data);
+                            in_flight++;
+                            continue;
+                        }
+                        if (cqe.res < 0) {
+                            errno = -cqe.res;
+                            throw io_error("Failed to read", name);
+                        }
+                        if (cqe.res == 0) {
+                            throw shrank(name);
+                        }
+                        done.filled += static_cast<size_t>(cqe.res);
+                        if (done.filled < done.len) { // Short read: ask for the rest
+                            ring.push_read(fd, done, cqe.user_data);
+                            in_flight++;
+                        }
+                    }
+                }
+            }
+            feed(sink, std::span(buf.data.get(), buf.len));
+            if (next < size) {
+                start(slot);
+                ring.enter(0);
+            }
+        }
+        return true;
+    }
+#else
+    bool uring_supported() {
+        return false;
+    }
+
+    bool read_uring(int, uint64_t, const ByteSink&, const std::string&) {
+        return false;
+    }
+#endif
+
+    void read_threaded(int fd, uint64_t size, const ByteSink& sink, const std::string& name) {
+        const size_t depth = depth_for(size);
+        const uint64_t parts = (size + ASYNC_BUFFER_SIZE - 1) / ASYNC_BUFFER_SIZE;
+        std::vector<Buffer> buffers(depth);
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        uint64_t filled = 0;   // Parts the reader has finished
+        uint64_t consumed = 0; // Parts the sink has finished
+        bool stop = false;
+        std::exception_ptr error;
+
+        std::thread reader([&] {
+            for (uint64_t part = 0; part < parts; part++) {
+                {
+                    std::unique_lock lock(mutex);
+                    changed.wait(lock, [&] { return stop || part - consumed < depth; });
+                    if (stop) {
+                        return;
+                    }
+                }
+                Buffer& buf = buffers[part % depth];
+                buf.offset = part * ASYNC_BUFFER_SIZE;
+                buf.len = static_cast<size_t>(std::min<uint64_t>(ASYNC_BUFFER_SIZE, size - buf.offset));
+                try {
+                    for (buf.filled = 0; buf.filled < buf.len;) {
+                        const ssize_t n = pread(fd, buf.data.get() + buf.filled, buf.len - buf.filled,
+                                                static_cast<off_t>(buf.offset + buf.filled));
+                        if (n < 0 && errno == EINTR) {
+                            continue;
+                        }
+                        if (n < 0) {
+                            throw io_error("Failed to read", name);
+                        }
+                        if (n == 0) {
+                            throw shrank(name);
+                        }
+                        buf.filled += static_cast<size_t>(n);
+                    }
+                } catch (...) {
+                    std::lock_guard lock(mutex);
+                    error = std::current_exception();
+                    changed.notify_all();
+                    return;
+                }
+                std::lock_guard lock(mutex);
+                filled = part + 1;
+                changed.notify_all();
+            }
+        });
+
+        struct Join {
+            std::thread& reader;
+            std::mutex& mutex;
+            std::condition_variable& changed;
+            bool& stop;
+            ~Join() {
+                {
+                    std::lock_guard lock(mutex);
+                    stop = true;
+                }
+                changed.notify_all();
+                reader.join();
+            }
+        } join{reader, mutex, changed, stop};
+
+        for (uint64_t part = 0; part < parts; part++) {
+            {
+                hash::stats::Timer timer(hash::stats::Counter::ReadNanos);
+                std::unique_lock lock(mutex);
+                changed.wait(lock, [&] { return filled > part || error; });
+                if (filled <= part) {
+                    std::rethrow_exception(error);
+                }
+            }
+            const Buffer& buf = buffers[part % depth];
+            feed(sink, std::span(buf.data.get(), buf.len));
+            std::lock_guard lock(mutex);
+            consumed = part + 1;
+            changed.notify_all();
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef OVERLAPPED_H
+#define OVERLAPPED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include <util/file.h>
+
+namespace utils {
+    // Hands one buffer to `sink` and counts it in the stats. Every read method goes through here.
+    void feed(const ByteSink& sink, std::span<const std::byte> data);
+
+    // Whether the kernel lets this process set up an io_uring (it may be too old or blocked by seccomp).
+    bool uring_supported();
+
+    /**
+     * Both read the first `size` bytes of regular file `fd` into ASYNC_DEPTH buffers of
+     * ASYNC_BUFFER_SIZE and feed them to `sink` in file order. Buffers are refilled as soon as
+     * `sink` is done with them, so the device is reading ahead while `sink` works.
+     * Throw std::runtime_error on I/O errors or if the file shrinks under them.
+     */
+    // Returns false, having read nothing, if no ring could be set up.
+    bool read_uring(int fd, uint64_t size, const ByteSink& sink, const std::string& name);
+    // One reader thread calling pread(), works everywhere.
+    void read_threaded(int fd, uint64_t size, const ByteSink& sink, const std::string& name);
+}
+
+#endif // OVERLAPPED_H
@@ -0,0 +1,103 @@
+#include <util/thread_pool.h>
+
+namespace utils {
+    namespace {
+        // The pool and worker index this thread belongs to, if it is a pool worker.
+        thread_local const ThreadPool* current_pool = nullptr;
+        thread_local size_t current_worker = 0;
+    }
+
+    unsigned ThreadPool::default_threads() {
+        unsigned n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : n;
+    }
+
+    ThreadPool::ThreadPool(unsigned threads) {
+        if (threads == 0) {
+            threads = default_threads();
+        }
+        for (unsigned i = 0; i < threads; i++) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (unsigned i = 0; i < threads; i++) {
+            workers.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(state_mutex);
+            stopping = true;
+        }
+        work_available.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::submit(std::function<void()> task) {
+        size_t target = current_pool == this ? current_worker : next_queue++ % queues.size();
+        {
+            std::lock_guard lock(queues[target]->mutex);
+            queues[target]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard lock(state_mutex);
+            queued++;
+            unfinished++;
+        }
+        work_available.notify_one();
+    }
+
+    void ThreadPool::wait() {
+        std::unique_lock lock(state_mutex);
+        all_done.wait(lock, [this] { return unfinished == 0; });
+    }
+
+    bool ThreadPool::pop_or_steal(size_t self, std::function<void()>& task) {
+        for (size_t i = 0; i < queues.size(); i++) {
+            Queue& q = *queues[(self + i) % queues.size()];
+            std::lock_guard lock(q.mutex);
+            if (q.tasks.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            } else {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::run(size_t self) {
+        current_pool = this;
+        current_worker = self;
+
+        while (true) {
+            {
+                std::unique_lock lock(state_mutex);
+                work_available.wait(lock, [this] { return queued > 0 || stopping; });
+                if (queued == 0) {
+                    return; // Stopping and nothing left
+                }
+                queued--; // Claim one task; it is guaranteed to be in some deque.
+            }
+
+            // submit() queues the task before bumping `queued`, so every claim finds one.
+            std::function<void()> task;
+            while (!pop_or_steal(self, task)) {
+                std::this_thread::yield();
+            }
+            task();
+
+            std::lock_guard lock(state_mutex);
+            if (--unfinished == 0) {
+                all_done.notify_all();
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+    /**
+     * Fixed set of workers, each with its own task deque. A worker pops its newest task
+     * first and, once its deque runs dry, steals the oldest task from another worker, so one
+     * slow task never strands the ones queued behind it.
+     *
+     * Tasks must not throw. wait() must not be called from inside a task.
+     */
+    class ThreadPool {
+    public:
+        // 0 threads means one per hardware thread.
+        explicit ThreadPool(unsigned threads = 0);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // Tasks submitted from a worker go on that worker's deque; others are dealt round-robin.
+        void submit(std::function<void()> task);
+        // Blocks until every submitted task has finished.
+        void wait();
+        unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+        static unsigned default_threads();
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        void run(size_t self);
+        bool pop_or_steal(size_t self, std::function<void()>& task);
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+        std::atomic<size_t> next_queue = 0;
+
+        // `queued` counts tasks sitting in a deque, `unfinished` those not yet completed.
+        std::mutex state_mutex;
+        std::condition_variable work_available;
+        std::condition_variable all_done;
+        size_t queued = 0;
+        size_t unfinished = 0;
+        bool stopping = false;
+    };
+
+    // Runs fn(i) for every i in [0, n) on `pool` and waits for all of them.
+    template<typename Fn>
+    void parallel_for(ThreadPool& pool, size_t n, Fn fn) {
+        for (size_t i = 0; i < n; i++) {
+            pool.submit([&fn, i] { fn(i); });
+        }
+        pool.wait();
+    }
+}
+
+#endif // THREAD_POOL_H
@@ -1,17 +1,18 @@
 #include <util/utils.h>
-#include <sstream>
-#include <iomanip>
+
+#include <hash/hex.h>
 
 namespace utils {
     std::string toString(const uint32_t* data, size_t size) {
-        std::stringstream ss;
-        ss << std::hex << std::setfill('0'); // Set output to hexadecimal and pad with 0
-
+        std::string out(8 * size, '\0');
+        char* p = out.data();
         for (size_t i = 0; i < size; ++i) {
-            uint32_t val = data[i];
-            // Each uint32_t is 8 hex characters (4 bytes * 2 hex chars/byte)
-            ss << std::setw(8) << val;
+            const std::byte word[4] = {
+                static_cast<std::byte>(data[i] >> 24), static_cast<std::byte>(data[i] >> 16),
+                static_cast<std::byte>(data[i] >> 8), static_cast<std::byte>(data[i]),
+            };
+            p = hash::hex::encode(word, p);
         }
-        return ss.str();
+        return out;
     }
 }
@@ -1,11 +1,10 @@
 #ifndef UTILS_H
 #define UTILS_H
 
-#include <iostream>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
-#include <sstream>
-#include <iomanip> // Required for std::hex, std::setfill, std::setw
 
 using Buffer = std::vector<uint8_t>;
 
@@ -13,6 +12,7 @@ namespace utils {
     // Lengths in bits
     constexpr int BYTE_LEN = 8;
 
+    // Hex of `size` words, each as 8 digits, most significant first.
     std::string toString(const uint32_t* data, size_t size);
 
     inline std::vector<char> to_buffer(const std::string& s) {
@@ -20,4 +20,4 @@ namespace utils {
     }
 }
 
-#endif // UTILS_H
\ No newline at end of file
+#endif // UTILS_H
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include <hash/cdc.h>
+#include <test/test_util.h>
+
+#include <filesystem>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace hash;
+
+namespace {
+    std::vector<std::byte> random_bytes(size_t n, uint32_t seed) {
+        std::vector<std::byte> out(n);
+        uint32_t x = seed;
+        for (auto& b : out) {
+            x = x * 1664525 + 1013904223;
+            b = static_cast<std::byte>(x >> 24);
+        }
+        return out;
+    }
+
+    // Small sizes so a few hundred KiB give plenty of chunks.
+    cdc::Params small_params() {
+        cdc::Params p;
+        p.min_size = 256;
+        p.avg_size = 1024;
+        p.max_size = 4096;
+        return p;
+    }
+
+    void expect_tiles(const std::vector<cdc::Chunk>& chunks, std::span<const std::byte> data, const cdc::Params& p) {
+        uint64_t offset = 0;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            const auto& c = chunks[i];
+            ASSERT_EQ(c.offset, offset);
+            ASSERT_LE(c.length, p.max_size);
+            if (i + 1 < chunks.size()) {
+                ASSERT_GT(c.length, p.min_size);
+            }
+            ASSERT_EQ(c.digest, sha1::to_digest(sha1::Hasher().update(data.subspan(c.offset, c.length)).finalize()));
+            offset += c.length;
+        }
+        EXPECT_EQ(offset, data.size());
+    }
+}
+
+TEST(CdcTests, ChunksTileTheInput) {
+    const auto data = random_bytes(300000, 1);
+    const auto params = small_params();
+    const auto chunks = cdc::chunk(data, params, 2);
+    expect_tiles(chunks, data, params);
+
+    // Normalized chunking keeps the mean near avg_size.
+    const double mean = static_cast<double>(data.size()) / static_cast<double>(chunks.size());
+    EXPECT_GT(mean, params.avg_size * 0.75);
+    EXPECT_LT(mean, params.avg_size * 1.5);
+}
+
+TEST(CdcTests, EmptyAndTinyInputs) {
+    EXPECT_TRUE(cdc::chunk({}).empty());
+    const auto tiny = random_bytes(10, 2);
+    const auto chunks = cdc::chunk(tiny);
+    ASSERT_EQ(chunks.size(), 1);
+    EXPECT_EQ(chunks[0].length, tiny.size());
+}
+
+TEST(CdcTests, ConstantInputCutsAtMaxSize) {
+    const std::vector<std::byte> zeros(10000);
+    const auto params = small_params();
+    const auto chunks = cdc::chunk(zeros, params);
+    ASSERT_EQ(chunks.size(), 3);
+    EXPECT_EQ(chunks[0].length, params.max_size);
+    EXPECT_EQ(chunks[1].length, params.max_size);
+    EXPECT_EQ(chunks[2].length, 10000 - 2 * params.max_size);
+}
+
+TEST(CdcTests, UpdateSizesDoNotMoveBoundaries) {
+    const auto data = random_bytes(100000, 3);
+    const auto params = small_params();
+    const auto expected = cdc::chunk(data, params, 1);
+    for (size_t piece : {1, 7, 300, 4095, 4096, 4097, 50000}) {
+        std::vector<cdc::Chunk> chunks;
+        cdc::Chunker chunker([&chunks](const cdc::Chunk& c) { chunks.push_back(c); }, params, 3);
+        for (size_t pos = 0; pos < data.size(); pos += piece) {
+            chunker.update(std::span(data).subspan(pos, std::min(piece, data.size() - pos)));
+        }
+        chunker.finalize();
+        ASSERT_EQ(chunks.size(), expected.size()) << "piece " << piece;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            EXPECT_EQ(chunks[i].offset, expected[i].offset) << "piece " << piece;
+            EXPECT_EQ(chunks[i].digest, expected[i].digest) << "piece " << piece;
+        }
+    }
+}
+
+TEST(CdcTests, InsertionOnlyDisturbsNearbyChunks) {
+    const auto data = random_bytes(200000, 4);
+    std::vector<std::byte> edited = data;
+    const auto inserted = random_bytes(100, 5);
+    edited.insert(edited.begin() + 50000, inserted.begin(), inserted.end());
+
+    const auto params = small_params();
+    const auto before = cdc::chunk(data, params);
+    const auto after = cdc::chunk(edited, params);
+    std::set<sha1::Digest> known;
+    for (const auto& c : before) {
+        known.insert(c.digest);
+    }
+    // Boundaries take a few chunks to fall back into step, after that nothing changes.
+    size_t changed = 0;
+    for (const auto& c : after) {
+        if (known.count(c.digest) == 0) {
+            changed++;
+            EXPECT_LT(c.offset, 60000);
+        }
+    }
+    EXPECT_GE(changed, 1);
+    EXPECT_LE(changed, 8);
+}
+
+TEST(CdcTests, FormatIsPinned) {
+    // Boundaries are part of format version 1; stored manifests rely on them.
+    const auto data = random_bytes(20000, 6);
+    const auto chunks = cdc::chunk(data, small_params());
+    std::vector<uint64_t> lengths;
+    for (const auto& c : chunks) {
+        lengths.push_back(c.length);
+    }
+    EXPECT_EQ(lengths, (std::vector<uint64_t>{1193, 1050, 1038, 1072, 1282, 1665, 1367, 1131, 1630, 1194,
+                                                  1262, 291, 1785, 1149, 1544, 1056, 291}));
+}
+
+TEST(CdcTests, FileMatchesMemory) {
+    TempDir dir("boogie_cdc_file_test");
+    const auto data = random_bytes(150000, 7);
+    const std::string path = dir.write("input.bin", std::string_view(reinterpret_cast<const char*>(data.data()), data.size()));
+
+    std::vector<cdc::Chunk> chunks;
+    cdc::chunk_file(path, [&chunks](const cdc::Chunk& c) { chunks.push_back(c); }, small_params(), 2);
+    expect_tiles(chunks, data, small_params());
+    EXPECT_EQ(chunks.size(), cdc::chunk(data, small_params()).size());
+}
+
+TEST(CdcTests, RejectsBadParams) {
+    auto params = small_params();
+    params.avg_size = 1000; // Not a power of two
+    EXPECT_THROW(params.validate(), std::invalid_argument);
+    EXPECT_THROW(cdc::chunk({}, params), std::invalid_argument);
+    params = small_params();
+    params.min_size = 8192; // Above avg
+    EXPECT_THROW(params.validate(), std::invalid_argument);
+    params = small_params();
+    params.max_size = 512; // Below avg
+    EXPECT_THROW(params.validate(), std::invalid_argument);
+    EXPECT_NO_THROW(cdc::Params{}.validate());
+}
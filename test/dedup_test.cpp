@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <hash/dedup.h>
+#include <test/test_util.h>
+
+#include <filesystem>
+#include <string>
+
+using namespace hash;
+
+namespace {
+    std::vector<std::string> roots_of(const TempDir& tree) { return {tree.root.string()}; }
+}
+
+TEST(DedupTests, FindsGroupsAndSkipsLookalikes) {
+    TempDir tree("boogie_dedup_groups_test");
+    const std::string big(1000, 'x');
+    std::string big_other = big;
+    big_other[500] = 'y'; // Same size, same ends: only the full hash tells them apart
+
+    const auto a = tree.write("a.txt", "hello world");
+    const auto b = tree.write("sub/b.txt", "hello world");
+    tree.write("c.txt", "hello there"); // Same size, different content
+    tree.write("unique.txt", "a size nobody else has");
+    const auto big1 = tree.write("big1", big);
+    const auto big2 = tree.write("deep/er/big2", big);
+    tree.write("big3", big_other);
+    tree.write("empty1", "");
+    tree.write("empty2", "");
+
+    dedup::Options opts;
+    opts.edge_bytes = 16;
+    const auto report = dedup::find_duplicates(roots_of(tree), opts);
+
+    ASSERT_EQ(report.groups.size(), 2);
+    EXPECT_EQ(report.groups[0].size, big.size());
+    EXPECT_EQ(report.groups[0].digest, sha1::to_digest(sha1::Hasher().update(big).finalize()));
+    EXPECT_EQ(report.groups[0].paths, (std::vector<std::string>{big1, big2}));
+    EXPECT_EQ(report.groups[1].paths, (std::vector<std::string>{a, b}));
+    EXPECT_EQ(report.files, 9);
+    EXPECT_EQ(report.reclaimable(), big.size() + 11);
+    EXPECT_TRUE(report.errors.empty());
+
+    // unique.txt and the empty files are never opened. The three big files are read at both
+    // ends and then in full, since their ends all match.
+    EXPECT_EQ(report.bytes_read, 3 * 11 + 3 * 32 + 3 * big.size());
+}
+
+TEST(DedupTests, SameResultForAnyThreadCount) {
+    TempDir tree("boogie_dedup_threads_test");
+    for (int i = 0; i < 40; i++) {
+        tree.write("f" + std::to_string(i), std::string(100 + i % 4, static_cast<char>('a' + i % 7)));
+    }
+    dedup::Options opts;
+    opts.edge_bytes = 8;
+    opts.threads = 1;
+    const auto serial = dedup::find_duplicates(roots_of(tree), opts);
+    opts.threads = 8;
+    const auto parallel = dedup::find_duplicates(roots_of(tree), opts);
+
+    ASSERT_FALSE(serial.groups.empty());
+    ASSERT_EQ(serial.groups.size(), parallel.groups.size());
+    for (size_t g = 0; g < serial.groups.size(); g++) {
+        EXPECT_EQ(serial.groups[g].paths, parallel.groups[g].paths);
+        EXPECT_EQ(serial.groups[g].digest, parallel.groups[g].digest);
+    }
+}
+
+TEST(DedupTests, HardLinksCountOnce) {
+    TempDir tree("boogie_dedup_links_test");
+    const auto original = tree.write("original", "linked content");
+    std::filesystem::create_hard_link(original, tree.root / "link");
+    std::filesystem::create_symlink(original, tree.root / "symlink");
+
+    const auto report = dedup::find_duplicates(roots_of(tree));
+    EXPECT_TRUE(report.groups.empty());
+    EXPECT_EQ(report.files, 1);
+}
+
+TEST(DedupTests, MissingRootIsReported) {
+    TempDir tree("boogie_dedup_missing_test");
+    const std::vector<std::string> roots{(tree.root / "nope").string()};
+    const auto report = dedup::find_duplicates(roots);
+    EXPECT_TRUE(report.groups.empty());
+    EXPECT_EQ(report.errors.size(), 1);
+}
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <hash/digest_cache.h>
+#include <test/test_util.h>
+
+#include <filesystem>
+#include <string>
+
+#include <sys/stat.h>
+
+using namespace hash;
+
+namespace {
+    std::string index_of(const TempDir& dir) { return (dir.root / "sha1.idx").string(); }
+
+    sha1::FileStamp stamp_of(const std::string& path) {
+        struct stat st;
+        EXPECT_EQ(stat(path.c_str(), &st), 0);
+        return sha1::FileStamp::of(st);
+    }
+}
+
+TEST(DigestCacheTests, MissingIndexIsEmpty) {
+    TempDir dir("boogie_cache_missing_test");
+    sha1::DigestCache cache(index_of(dir));
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_FALSE(cache.lookup(sha1::FileStamp{1, 2, 3, 4, 5}).has_value());
+    cache.commit(); // Nothing stored, nothing written
+    EXPECT_FALSE(std::filesystem::exists(index_of(dir)));
+}
+
+TEST(DigestCacheTests, StoreCommitReopen) {
+    TempDir dir("boogie_cache_reopen_test");
+    const sha1::Digest digest = sha1::to_digest(sha1::Hasher().update("boogie").finalize());
+    {
+        sha1::DigestCache cache(index_of(dir));
+        for (uint64_t ino = 0; ino < 1000; ino++) {
+            cache.store(sha1::FileStamp{7, ino, ino * 10, 100, 200}, digest);
+        }
+        cache.commit();
+        EXPECT_EQ(cache.size(), 1000);
+    }
+
+    sha1::DigestCache cache(index_of(dir));
+    EXPECT_EQ(cache.size(), 1000);
+    EXPECT_EQ(cache.lookup(sha1::FileStamp{7, 42, 420, 100, 200}), digest);
+    // Any field moving makes the entry stale.
+    EXPECT_FALSE(cache.lookup(sha1::FileStamp{7, 42, 421, 100, 200}).has_value());
+    EXPECT_FALSE(cache.lookup(sha1::FileStamp{7, 42, 420, 101, 200}).has_value());
+    EXPECT_FALSE(cache.lookup(sha1::FileStamp{7, 42, 420, 100, 201}).has_value());
+    EXPECT_FALSE(cache.lookup(sha1::FileStamp{8, 42, 420, 100, 200}).has_value());
+    EXPECT_EQ(cache.stats().hits, 1);
+    EXPECT_EQ(cache.stats().misses, 4);
+
+    cache.set_refresh(true);
+    EXPECT_FALSE(cache.lookup(sha1::FileStamp{7, 42, 420, 100, 200}).has_value());
+}
+
+TEST(DigestCacheTests, CommitsMergeAcrossInstances) {
+    TempDir dir("boogie_cache_merge_test");
+    const sha1::Digest a = sha1::to_digest(sha1::Hasher().update("a").finalize());
+    const sha1::Digest b = sha1::to_digest(sha1::Hasher().update("b").finalize());
+
+    // Both open the same (empty) snapshot; the second commit must keep the first one's entries.
+    sha1::DigestCache first(index_of(dir));
+    sha1::DigestCache second(index_of(dir));
+    first.store(sha1::FileStamp{1, 1, 1, 1, 1}, a);
+    second.store(sha1::FileStamp{1, 2, 1, 1, 1}, b);
+    second.store(sha1::FileStamp{1, 1, 2, 2, 2}, b); // Newer version of first's file
+    first.commit();
+    second.commit();
+
+    sha1::DigestCache reader(index_of(dir));
+    EXPECT_EQ(reader.size(), 2);
+    EXPECT_FALSE(reader.lookup(sha1::FileStamp{1, 1, 1, 1, 1}).has_value());
+    EXPECT_EQ(reader.lookup(sha1::FileStamp{1, 1, 2, 2, 2}), b);
+    EXPECT_EQ(reader.lookup(sha1::FileStamp{1, 2, 1, 1, 1}), b);
+}
+
+TEST(DigestCacheTests, HashFileSkipsUnchangedFiles) {
+    TempDir dir("boogie_cache_hash_file_test");
+    const std::string path = dir.write("f", "let's boogie\n");
+    const std::string expected = sha1::hash_file(path);
+    {
+        sha1::DigestCache cache(index_of(dir));
+        cache.set_racy_window(0);
+        EXPECT_EQ(sha1::hash_file(path, cache), expected);
+        EXPECT_EQ(cache.stats().misses, 1);
+        cache.commit();
+    }
+
+    sha1::DigestCache cache(index_of(dir));
+    EXPECT_EQ(cache.lookup(stamp_of(path)), sha1::to_digest(sha1::Hasher().update("let's boogie\n").finalize()));
+    EXPECT_EQ(sha1::hash_file(path, cache), expected);
+    EXPECT_EQ(cache.stats().hits, 2);
+
+    // Rewriting the file bumps its ctime even if the size and mtime come out the same.
+    dir.write("f", "let's boogiE\n");
+    EXPECT_EQ(sha1::hash_file(path, cache), sha1::hash_file(path));
+}
+
+TEST(DigestCacheTests, RecentlyModifiedFilesAreNotStored) {
+    TempDir dir("boogie_cache_racy_test");
+    const std::string path = dir.write("f", "fresh");
+    sha1::DigestCache cache(index_of(dir));
+    sha1::hash_file(path, cache);
+    cache.commit();
+    EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(DigestCacheTests, CorruptIndexIsReplaced) {
+    TempDir dir("boogie_cache_corrupt_test");
+    dir.write("sha1.idx", std::string(4096, 'x'));
+    sha1::DigestCache cache(index_of(dir));
+    EXPECT_EQ(cache.size(), 0);
+    cache.store(sha1::FileStamp{1, 1, 1, 1, 1}, sha1::Digest{});
+    cache.commit();
+    EXPECT_EQ(sha1::DigestCache(index_of(dir)).size(), 1);
+}
+
+TEST(DigestCacheTests, PruneKeepsOnlyWhatWasUsed) {
+    TempDir dir("boogie_cache_prune_test");
+    {
+        sha1::DigestCache cache(index_of(dir));
+        for (uint64_t ino = 0; ino < 100; ino++) {
+            cache.store(sha1::FileStamp{3, ino, 1, 1, 1}, sha1::Digest{});
+        }
+        cache.commit();
+    }
+    {
+        sha1::DigestCache cache(index_of(dir));
+        cache.set_prune(true);
+        EXPECT_TRUE(cache.lookup(sha1::FileStamp{3, 10, 1, 1, 1}).has_value());
+        EXPECT_FALSE(cache.lookup(sha1::FileStamp{3, 11, 2, 1, 1}).has_value()); // Changed since, so stale
+        cache.store(sha1::FileStamp{3, 200, 1, 1, 1}, sha1::Digest{});
+        cache.commit();
+        EXPECT_EQ(cache.size(), 2);
+    }
+
+    sha1::DigestCache cache(index_of(dir));
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_TRUE(cache.lookup(sha1::FileStamp{3, 10, 1, 1, 1}).has_value());
+    EXPECT_TRUE(cache.lookup(sha1::FileStamp{3, 200, 1, 1, 1}).has_value());
+    EXPECT_FALSE(cache.lookup(sha1::FileStamp{3, 12, 1, 1, 1}).has_value());
+
+    // Without pruning, entries nobody looked at stay.
+    cache.store(sha1::FileStamp{3, 300, 1, 1, 1}, sha1::Digest{});
+    cache.commit();
+    EXPECT_EQ(cache.size(), 3);
+}
+
+TEST(DigestCacheTests, HashFilesUsesCache) {
+    TempDir dir("boogie_cache_hash_files_test");
+    std::vector<std::string> paths;
+    for (int i = 0; i < 20; i++) {
+        paths.push_back(dir.write("f" + std::to_string(i), std::string(i * 100, 'c')));
+    }
+    sha1::DigestCache cache(index_of(dir));
+    cache.set_racy_window(0);
+    for (int pass = 0; pass < 2; pass++) {
+        sha1::hash_files(paths, 4, [&](size_t i, const sha1::FileResult& result) {
+            ASSERT_TRUE(result.ok()) << result.error;
+            EXPECT_EQ(sha1::to_hex(result.raw_hash), sha1::hash_file(paths[i]));
+        }, &cache);
+        cache.commit();
+    }
+    EXPECT_EQ(cache.stats().misses, paths.size());
+    EXPECT_EQ(cache.stats().hits, paths.size());
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <util/file.h>
+
+#include <hash/sha1.h>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    // Restores the process-wide read method when a test is done with it.
+    struct MethodGuard {
+        utils::ReadMethod original = utils::active_read_method();
+        ~MethodGuard() { utils::set_read_method(original); }
+    };
+
+    struct TempFile {
+        std::filesystem::path path;
+
+        TempFile(const std::string& name, size_t size) : path(std::filesystem::temp_directory_path() / name) {
+            std::string content(size, '\0');
+            uint32_t x = static_cast<uint32_t>(size);
+            for (char& c : content) {
+                x = x * 1664525 + 1013904223;
+                c = static_cast<char>(x >> 24);
+            }
+            std::ofstream(path, std::ios::binary).write(content.data(), static_cast<std::streamsize>(content.size()));
+            expected = hash::sha1::hash_string(content);
+        }
+        ~TempFile() { std::filesystem::remove(path); }
+
+        std::string expected;
+    };
+
+    std::vector<utils::ReadMethod> supported_methods() {
+        std::vector<utils::ReadMethod> methods;
+        for (auto m : {utils::ReadMethod::Map, utils::ReadMethod::Uring, utils::ReadMethod::Thread}) {
+            if (utils::read_method_supported(m)) {
+                methods.push_back(m);
+            }
+        }
+        return methods;
+    }
+}
+
+TEST(FileTests, EveryReadMethodHashesTheSame) {
+    MethodGuard guard;
+    // Enough parts to reuse every buffer twice, with a short one at the end.
+    TempFile file("boogie_read_methods_test", 2 * utils::ASYNC_DEPTH * utils::ASYNC_BUFFER_SIZE + 12345);
+    for (auto method : supported_methods()) {
+        ASSERT_TRUE(utils::set_read_method(method));
+        EXPECT_EQ(hash::sha1::hash_file(file.path.string()), file.expected) << utils::read_method_name(method);
+    }
+}
+
+TEST(FileTests, OverlappedReadsArriveInOrder) {
+    MethodGuard guard;
+    TempFile file("boogie_read_order_test", 5 * utils::ASYNC_BUFFER_SIZE + 1);
+    for (auto method : supported_methods()) {
+        ASSERT_TRUE(utils::set_read_method(method));
+        utils::File f(file.path.string());
+        std::vector<size_t> sizes;
+        auto ctx = hash::sha1::makeContext();
+        utils::read_all(f.fd(), [&](std::span<const std::byte> data) {
+            sizes.push_back(data.size());
+            hash::sha1::update(ctx, data);
+        }, "test");
+        EXPECT_EQ(hash::sha1::to_hex(hash::sha1::finalize(ctx)), file.expected) << utils::read_method_name(method);
+        if (method != utils::ReadMethod::Map) {
+            const size_t b = utils::ASYNC_BUFFER_SIZE;
+            EXPECT_EQ(sizes, (std::vector<size_t>{b, b, b, b, b, 1})) << utils::read_method_name(method);
+        }
+    }
+}
+
+TEST(FileTests, SmallFilesAreMappedWhole) {
+    MethodGuard guard;
+    TempFile file("boogie_read_small_test", 100000);
+    for (auto method : supported_methods()) {
+        ASSERT_TRUE(utils::set_read_method(method));
+        utils::File f(file.path.string());
+        size_t calls = 0;
+        utils::read_all(f.fd(), [&](std::span<const std::byte>) { calls++; }, "test");
+        EXPECT_EQ(calls, 1) << utils::read_method_name(method);
+    }
+}
+
+TEST(FileTests, SinkErrorStopsOverlappedReads) {
+    MethodGuard guard;
+    TempFile file("boogie_read_abort_test", 4 * utils::ASYNC_BUFFER_SIZE);
+    for (auto method : supported_methods()) {
+        if (method == utils::ReadMethod::Map) {
+            continue; // One window, one call
+        }
+        ASSERT_TRUE(utils::set_read_method(method));
+        utils::File f(file.path.string());
+        size_t calls = 0;
+        auto sink = [&](std::span<const std::byte>) {
+            if (++calls == 2) {
+                throw std::runtime_error("sink gave up");
+            }
+        };
+        EXPECT_THROW(utils::read_all(f.fd(), sink, "test"), std::runtime_error) << utils::read_method_name(method);
+        EXPECT_EQ(calls, 2);
+    }
+}
+
+TEST(FileTests, ReadMethodNames) {
+    EXPECT_EQ(utils::read_method_name(utils::ReadMethod::Map), "map");
+    EXPECT_EQ(utils::read_method_name(utils::ReadMethod::Uring), "uring");
+    EXPECT_EQ(utils::read_method_name(utils::ReadMethod::Thread), "thread");
+    EXPECT_TRUE(utils::read_method_supported(utils::ReadMethod::Thread));
+}
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <hash/git.h>
+#include <test/test_util.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+
+using namespace hash;
+
+TEST(GitTests, BlobId) {
+    // Known values from `git hash-object`
+    EXPECT_EQ(sha1::to_hex(git::blob_id({})), "e69de29bb2d1d6434b8b29ae775ad8c2e48c5391");
+    EXPECT_EQ(sha1::to_hex(git::blob_id(bytes("hello\n"))), "ce013625030ba8dba906f756967f9e9ca394464a");
+}
+
+TEST(GitTests, EmptyTree) {
+    EXPECT_EQ(sha1::to_hex(git::tree_id({})), "4b825dc642cb6eb9a060e54bf8d69288fbee4904");
+}
+
+TEST(GitTests, TreeEntryOrder) {
+    // "a" is a directory so it sorts as "a/", after "a-b" and "a.txt"
+    git::ObjectId blob = git::blob_id(bytes("x"));
+    std::vector<git::TreeEntry> entries = {
+        {std::string(git::MODE_TREE), "a", git::tree_id({{std::string(git::MODE_FILE), "f", blob}})},
+        {std::string(git::MODE_FILE), "a.txt", blob},
+        {std::string(git::MODE_FILE), "a-b", blob},
+    };
+    auto reversed = entries;
+    std::reverse(reversed.begin(), reversed.end());
+    EXPECT_EQ(git::tree_id(entries), git::tree_id(reversed));
+}
+
+TEST(GitTests, WriteTreeMatchesGit) {
+    TempDir dir("boogie_git_tree_test");
+    std::filesystem::create_directories(dir.root / "empty" / "inner");
+    std::filesystem::create_directories(dir.root / ".git" / "objects");
+    dir.write("a/file", "alpha\n");
+    dir.write("a-b/file", "beta");
+    dir.write("a.txt", "top\n");
+    const std::string script = dir.write("run.sh", "#!/bin/sh\necho boogie\n");
+    dir.write(".git/HEAD", "ignored\n");
+    std::filesystem::permissions(script, std::filesystem::perms::owner_exec, std::filesystem::perm_options::add);
+    std::filesystem::create_symlink("a.txt", dir.root / "link");
+
+    EXPECT_EQ(sha1::to_hex(git::hash_blob_file(script)), "04e6e8f9a2f995480d1d1d24f96fb4b0792dd5d7");
+    // `git add -A && git write-tree` on the same layout
+    for (unsigned threads : {1u, 4u}) {
+        EXPECT_EQ(sha1::to_hex(git::write_tree(dir.root.string(), threads)), "6f9a28bd933714e391f39cb773d9828cbbd91501");
+    }
+}
+
+TEST(GitTests, WriteTreeRecordsNestedRepositoriesAsGitlinks) {
+    TempDir dir("boogie_git_gitlink_test");
+    // A repository checked out in place, its branch in a loose ref. Its files are not descended into.
+    dir.write("top.txt", "top\n");
+    dir.write("sub/.git/HEAD", "ref: refs/heads/main\n");
+    dir.write("sub/.git/refs/heads/main", std::string(40, '1') + "\n");
+    dir.write("sub/file", "not hashed");
+    // A submodule as `git submodule add` leaves it, the branch packed.
+    dir.write("mod/.git", "gitdir: ../.git/modules/mod\n");
+    dir.write(".git/modules/mod/HEAD", "ref: refs/heads/main\n");
+    dir.write(".git/modules/mod/packed-refs",
+              "# pack-refs with: peeled fully-peeled sorted\n" + std::string(40, '2') + " refs/heads/main\n");
+
+    // `git update-index --cacheinfo 160000,...` of the same two commits, then `git write-tree`
+    EXPECT_EQ(sha1::to_hex(git::write_tree(dir.root.string())), "c389fa571ad7f80a72c9ea09d87ae6ce698a94f1");
+
+    // Detached HEADs name the commit directly.
+    dir.write("sub/.git/HEAD", std::string(40, '1') + "\n");
+    EXPECT_EQ(sha1::to_hex(git::write_tree(dir.root.string())), "c389fa571ad7f80a72c9ea09d87ae6ce698a94f1");
+
+    // Nothing committed yet, so there is nothing to link to.
+    dir.write("sub/.git/HEAD", "ref: refs/heads/unborn\n");
+    EXPECT_THROW(git::write_tree(dir.root.string()), std::runtime_error);
+}
+
+TEST(GitTests, WriteTreeMissingDirectory) {
+    EXPECT_THROW(git::write_tree("/nonexistent/boogie/dir"), std::runtime_error);
+}
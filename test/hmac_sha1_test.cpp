@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <hash/hmac_sha1.h>
+#include <test/test_util.h>
+
+#include <string>
+#include <vector>
+
+using namespace hash;
+
+namespace {
+    struct Rfc2202Case {
+        std::string key;
+        std::string data;
+        std::string digest;
+    };
+
+    std::string counting_key() {
+        std::string key;
+        for (char c = 1; c <= 25; c++) {
+            key.push_back(c);
+        }
+        return key;
+    }
+
+    // https://datatracker.ietf.org/doc/html/rfc2202#section-3
+    const std::vector<Rfc2202Case> rfc2202 = {
+        {std::string(20, '\x0b'), "Hi There", "b617318655057264e28bc0b6fb378c8ef146be00"},
+        {"Jefe", "what do ya want for nothing?", "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79"},
+        {std::string(20, '\xaa'), std::string(50, '\xdd'), "125d7342b9ac11cd91a39af48aa17b4f63f175d3"},
+        {counting_key(), std::string(50, '\xcd'), "4c9007f4026250c6bc8414f9bf50c86c2d7235da"},
+        {std::string(20, '\x0c'), "Test With Truncation", "4c1a03424b55e07fe7f27be1d58bb9324a9a5a04"},
+        {std::string(80, '\xaa'), "Test Using Larger Than Block-Size Key - Hash Key First",
+         "aa4ae5e15272d00e95705637ce8a3b55ed402112"},
+        {std::string(80, '\xaa'), "Test Using Larger Than Block-Size Key and Larger Than One Block-Size Data",
+         "e8e99d0f45237d786d6bbaa7965c7808bbff1a91"},
+    };
+}
+
+TEST(HmacSha1Tests, Rfc2202Vectors) {
+    for (const auto& [key, data, digest] : rfc2202) {
+        const hmac_sha1::Key k(key);
+        EXPECT_EQ(sha1::to_hex(k.sign(bytes(data))), digest);
+
+        // Same MAC fed one byte at a time.
+        hmac_sha1::Mac mac = k.begin();
+        for (char c : data) {
+            mac.update(std::string_view(&c, 1));
+        }
+        EXPECT_EQ(sha1::to_hex(mac.finalize()), digest);
+    }
+}
+
+TEST(HmacSha1Tests, KeyIsReusable) {
+    const hmac_sha1::Key key("Jefe");
+    const auto first = key.sign(bytes("what do ya want for nothing?"));
+    key.sign(bytes(std::string(1000, 'x')));
+    EXPECT_EQ(key.sign(bytes("what do ya want for nothing?")), first);
+}
+
+TEST(HmacSha1Tests, Verify) {
+    const hmac_sha1::Key key("Jefe");
+    const std::string message = "what do ya want for nothing?";
+    hmac_sha1::Digest tag = key.sign(bytes(message));
+    EXPECT_TRUE(key.verify(bytes(message), tag));
+    tag[19] ^= std::byte{1};
+    EXPECT_FALSE(key.verify(bytes(message), tag));
+    EXPECT_FALSE(hmac_sha1::equal(tag, std::span(tag).first(19)));
+}
+
+TEST(HmacSha1Tests, VerifyMany) {
+    const hmac_sha1::Key key(std::string(20, '\x0b'));
+    std::vector<std::string> storage;
+    std::vector<std::span<const std::byte>> messages;
+    std::vector<hmac_sha1::Digest> tags;
+    for (size_t len = 0; len < 200; len += 13) {
+        storage.push_back(std::string(len, static_cast<char>('a' + len % 26)));
+    }
+    for (const auto& s : storage) {
+        messages.push_back(bytes(s));
+        tags.push_back(key.sign(bytes(s)));
+    }
+    bool ok[16];
+    ASSERT_EQ(messages.size(), std::size(ok));
+    EXPECT_TRUE(hmac_sha1::verify_many(key, messages, tags, ok));
+
+    tags[5][0] ^= std::byte{0x80};
+    EXPECT_FALSE(hmac_sha1::verify_many(key, messages, tags, ok));
+    for (size_t i = 0; i < std::size(ok); i++) {
+        EXPECT_EQ(ok[i], i != 5);
+    }
+    EXPECT_THROW(hmac_sha1::verify_many(key, messages, std::span(tags).first(3), ok), std::invalid_argument);
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <util/output.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+    // Collects whatever an OutputWriter writes to a temporary file of its own, so tests can run in parallel.
+    struct Capture {
+        std::filesystem::path path;
+        int fd;
+
+        Capture() {
+            std::string name = (std::filesystem::temp_directory_path() / "boogie_output_test_XXXXXX").string();
+            fd = mkstemp(name.data());
+            path = name;
+        }
+
+        ~Capture() {
+            close(fd);
+            std::filesystem::remove(path);
+        }
+
+        std::string contents() const {
+            std::ifstream in(path, std::ios::binary);
+            std::stringstream ss;
+            ss << in.rdbuf();
+            return ss.str();
+        }
+    };
+}
+
+TEST(OutputTests, FormatsLines) {
+    Capture capture;
+    {
+        utils::OutputWriter out(capture.fd);
+        const std::byte bytes[] = {std::byte{0x00}, std::byte{0xab}, std::byte{0xff}};
+        out.hex(bytes).put(' ').number(0).put(' ').number(18446744073709551615ULL).write("  name").end_line();
+        out.write("second").end_line();
+    }
+    EXPECT_EQ(capture.contents(), "00abff 0 18446744073709551615  name\nsecond\n");
+}
+
+TEST(OutputTests, HoldsOutputUntilFlushed) {
+    Capture capture;
+    utils::OutputWriter out(capture.fd);
+    out.write("pending").end_line(); // Not a terminal, so nothing is written yet
+    EXPECT_EQ(capture.contents(), "");
+    out.flush();
+    EXPECT_EQ(capture.contents(), "pending\n");
+}
+
+TEST(OutputTests, WritesMoreThanOneBuffer) {
+    Capture capture;
+    std::string expected;
+    {
+        utils::OutputWriter out(capture.fd);
+        const std::string big(3 * utils::OUTPUT_BUFFER_SIZE + 17, 'x');
+        out.write(big);
+        expected += big;
+        std::vector<std::byte> bytes(utils::OUTPUT_BUFFER_SIZE, std::byte{0x5a});
+        out.hex(bytes);
+        for (size_t i = 0; i < bytes.size(); i++) {
+            expected += "5a";
+        }
+        for (int i = 0; i < 100000; i++) {
+            out.number(static_cast<uint64_t>(i)).end_line();
+            expected += std::to_string(i) + "\n";
+        }
+    }
+    EXPECT_EQ(capture.contents(), expected);
+}
+
+TEST(OutputTests, ReportsWriteErrors) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    close(fds[0]);
+    auto previous = std::signal(SIGPIPE, SIG_IGN);
+    {
+        utils::OutputWriter out(fds[1]);
+        out.write("nobody is listening");
+        EXPECT_THROW(out.flush(), std::runtime_error);
+    }
+    close(fds[1]);
+    std::signal(SIGPIPE, previous);
+}
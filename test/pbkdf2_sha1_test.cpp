@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <hash/pbkdf2_sha1.h>
+#include <test/test_util.h>
+
+#include <string>
+#include <vector>
+
+using namespace hash;
+
+namespace {
+    std::string to_hex(std::span<const std::byte> data) {
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string hex;
+        for (std::byte b : data) {
+            hex += digits[std::to_integer<unsigned>(b) >> 4];
+            hex += digits[std::to_integer<unsigned>(b) & 0xf];
+        }
+        return hex;
+    }
+
+    std::string derive_hex(const std::string& password, const std::string& salt, uint32_t iterations, size_t len,
+                           unsigned threads = 0) {
+        std::vector<std::byte> out(len);
+        pbkdf2_sha1::derive(bytes(password), bytes(salt), iterations, out, threads);
+        return to_hex(out);
+    }
+}
+
+// https://datatracker.ietf.org/doc/html/rfc6070#section-2
+// The 16777216 iteration vector is left out to keep the suite fast.
+TEST(Pbkdf2Sha1Tests, Rfc6070Vectors) {
+    for_each_batch_backend([](sha1::BatchBackend) {
+        EXPECT_EQ(derive_hex("password", "salt", 1, 20), "0c60c80f961f0e71f3a9b524af6012062fe037a6");
+        EXPECT_EQ(derive_hex("password", "salt", 2, 20), "ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957");
+        EXPECT_EQ(derive_hex("password", "salt", 4096, 20), "4b007901b765489abead49d926f721d065a429c1");
+        EXPECT_EQ(derive_hex("passwordPASSWORDpassword", "saltSALTsaltSALTsaltSALTsaltSALTsalt", 4096, 25),
+                  "3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038");
+        EXPECT_EQ(derive_hex(std::string("pass\0word", 9), std::string("sa\0lt", 5), 4096, 16),
+                  "56fa6aa75548099dcc37d7f03425e0c3");
+    });
+}
+
+TEST(Pbkdf2Sha1Tests, Wpa2Psk) {
+    // IEEE 802.11i-2004 annex H.4: passphrase "password", SSID "IEEE"
+    EXPECT_EQ(derive_hex("password", "IEEE", 4096, 32, 2),
+              "f42c6fc52df0ebef9ebb4b90b38a5f902e83fe1b135a70e23aed762e9710a12e");
+}
+
+TEST(Pbkdf2Sha1Tests, ManyPasswordsMatchOneAtATime) {
+    // 37 requests of mixed lengths leave a partial lane group at the end.
+    std::vector<std::string> passwords;
+    std::vector<std::vector<std::byte>> outs;
+    std::vector<pbkdf2_sha1::Request> requests;
+    const std::string salt = "boogie salt";
+    for (size_t i = 0; i < 37; i++) {
+        passwords.push_back(std::string(i * 3, static_cast<char>('a' + i % 26)));
+        outs.emplace_back(1 + (i * 11) % 64);
+    }
+    for (size_t i = 0; i < passwords.size(); i++) {
+        requests.push_back({bytes(passwords[i]), bytes(salt), outs[i]});
+    }
+
+    for_each_batch_backend([&](sha1::BatchBackend) {
+        pbkdf2_sha1::derive_many(requests, 100, 3);
+        for (size_t i = 0; i < passwords.size(); i++) {
+            EXPECT_EQ(to_hex(outs[i]), derive_hex(passwords[i], salt, 100, outs[i].size(), 1)) << "request " << i;
+        }
+    });
+}
+
+TEST(Pbkdf2Sha1Tests, InvalidArguments) {
+    std::vector<std::byte> out(20);
+    EXPECT_THROW(pbkdf2_sha1::derive(bytes("p"), bytes("s"), 0, out), std::invalid_argument);
+    pbkdf2_sha1::derive(bytes("p"), bytes("s"), 1, {}); // Empty key is a no-op
+    pbkdf2_sha1::derive_many({}, 1);
+}
@@ -1,86 +1,92 @@
 #include <gtest/gtest.h>
 
 #include <hash/sha1.h>
+#include <util/file.h>
 #include <util/utils.h>
 #include <test/assets/words.h>
+#include <test/test_util.h>
+#include <cctype>
+#include <cstring>
 #include <filesystem>
+#include <span>
+#include <thread>
+
+#include <unistd.h>
 
 using namespace hash;
 class SHA1Tests
   : public ::testing::TestWithParam<std::pair<std::string,std::string>> {};
 
 TEST(SHA1Tests, MakeContextTest) {
-    const std::string& message = "I need context!";
     auto gotContext = sha1::makeContext();
-    EXPECT_EQ(gotContext.b1.size(), 5);
-    for (auto elem : gotContext.b1) {
-        EXPECT_EQ(elem, 0x0);
-    }
     EXPECT_EQ(gotContext.H.size(), 5);
-    EXPECT_EQ(gotContext.w.size(), 80);
+    EXPECT_EQ(gotContext.H[0], 0x67452301);
+    EXPECT_EQ(gotContext.H[4], 0xC3D2E1F0);
+    EXPECT_EQ(gotContext.block_len, 0);
+    EXPECT_EQ(gotContext.message_len, 0);
 }
 
 TEST_P(SHA1Tests, SHA1PadTest) {
     const std::string& message = GetParam().first;
-    std::vector<char> buf = utils::to_buffer(message);
-    uint64_t message_len = buf.size();
-    sha1::sha1_pad(buf, message_len, 0); 
+    std::vector<std::byte> buf(sha1::padded_len(message.size()));
+    std::memcpy(buf.data(), message.data(), message.size());
+    uint64_t message_len = message.size();
+    size_t padded = sha1::sha1_pad(buf, message_len, 0); 
 
+    EXPECT_EQ(padded, buf.size());
     EXPECT_EQ(buf.size() % (sha1::SHA1_BLOCK_LEN / utils::BYTE_LEN), 0); // length should be blocks of 512 bits
 
     // Check message
-    for (int i = 0; i < message.size(); i++) {
-        EXPECT_EQ(buf[i], message[i]);
+    for (size_t i = 0; i < message.size(); i++) {
+        EXPECT_EQ(buf[i], static_cast<std::byte>(message[i]));
     }
 
-    EXPECT_EQ(buf[message_len], (char) 0x80);
+    EXPECT_EQ(buf[message_len], std::byte{0x80});
     // Zero pad
     uint zero_pad_range = buf.size() - ((sha1::SHA1_WORD_LEN  * 2) / utils::BYTE_LEN);
-    for (int i = message.size() + 1; i < zero_pad_range; i++) {
-        EXPECT_EQ(buf[i], (char) 0x00);
+    for (size_t i = message.size() + 1; i < zero_pad_range; i++) {
+        EXPECT_EQ(buf[i], std::byte{0x00});
     }
 
     // Check encoded length
     uint64_t len = 0;
     const uint encoded_len_length = sha1::SHA1_WORD_LEN / utils::BYTE_LEN;
-    for (int i = buf.size() - encoded_len_length; i < buf.size(); i++) {
+    for (size_t i = buf.size() - encoded_len_length; i < buf.size(); i++) {
         len <<= utils::BYTE_LEN;
-        len |= (uint8_t) buf[i];
+        len |= std::to_integer<uint8_t>(buf[i]);
     }
     EXPECT_EQ(len, message.size() * utils::BYTE_LEN);
 }
 
-TEST_P(SHA1Tests, ToMessageDigestBufferTest) {
-    const std::string& message = GetParam().first;
-    std::vector<char> buf = utils::to_buffer(message);
-    uint64_t message_len = buf.size();
-    sha1::sha1_pad(buf, message_len, 0); 
-    auto got_buffer = sha1::toMessageDigestBuffer(buf, buf.size());
-    ASSERT_TRUE(got_buffer);
-
-    // Each word should be 4 bytes
-    ASSERT_EQ(buf.size() % 4, 0);
-    ASSERT_EQ(got_buffer->size(), buf.size() / 4);
-
-    // Check the words
-    for (size_t i = 0; i < got_buffer->size(); i++) {
-        uint32_t expectedWord = 0;
-        for (size_t j = 0; j < 4; ++j) {
-            expectedWord |= (static_cast<uint32_t>(static_cast<unsigned char>(buf[i * 4 + j])) << ((3 - j) * 8));
-        }
-        EXPECT_EQ(got_buffer->at(i), expectedWord);
-    }
-}
-
-TEST_P(SHA1Tests, ProcessDigestTest) {
+TEST_P(SHA1Tests, UpdateFinalizeDigestTest) {
     const auto& [message, expected_hash] = GetParam();
     auto ctx = sha1::makeContext();
-    std::vector<char> data = utils::to_buffer(message);
-    sha1::process(ctx, data, data.size(), true);
+    sha1::update(ctx, std::as_bytes(std::span(message.data(), message.size())));
+    sha1::finalize(ctx);
     std::string s = utils::toString(ctx.H.data(), ctx.H.size());
     EXPECT_EQ(s, expected_hash);
 }
 
+TEST_P(SHA1Tests, UpdateSplitPointsTest) {
+    const auto& [message, expected_hash] = GetParam();
+    const auto bytes = std::as_bytes(std::span(message.data(), message.size()));
+
+    // Every single split point, then a few uneven chunkings that straddle block boundaries.
+    for (size_t split = 0; split <= bytes.size(); split++) {
+        sha1::Hasher hasher;
+        hasher.update(bytes.first(split));
+        hasher.update(bytes.subspan(split));
+        EXPECT_EQ(sha1::to_hex(hasher.finalize()), expected_hash) << "split at " << split;
+    }
+    for (size_t step : {1, 3, 63, 64, 65, 127, 1000}) {
+        sha1::Hasher hasher;
+        for (size_t pos = 0; pos < bytes.size(); pos += step) {
+            hasher.update(bytes.subspan(pos, std::min(step, bytes.size() - pos)));
+        }
+        EXPECT_EQ(sha1::to_hex(hasher.finalize()), expected_hash) << "step " << step;
+    }
+}
+
 TEST_P(SHA1Tests, HashTest) {
     const auto& [message, expected_hash] = GetParam();
     auto result = sha1::hash_string(message);
@@ -97,4 +103,254 @@ TEST(SHA1Tests, HashFile) {
     const std::string bee_movie_path = current_dir + "/assets/bee_movie.txt";
     auto r = sha1::hash_file(bee_movie_path);
     EXPECT_EQ(r, "93ae3d6436613af8a6957db81e1701fbc50de7a8");
-}
\ No newline at end of file
+}
+
+TEST(SHA1Tests, HashFileMissing) {
+    EXPECT_THROW(sha1::hash_file("/nonexistent/boogie/file"), std::runtime_error);
+}
+
+TEST(SHA1Tests, HashFileEmpty) {
+    TempDir dir("boogie_empty_test");
+    EXPECT_EQ(sha1::hash_file(dir.write("empty", "")), "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+}
+
+TEST(SHA1Tests, HashFdPipe) {
+    // Bigger than the read() buffer so the fallback path loops.
+    std::string message(utils::READ_BUFFER_SIZE * 2 + 17, 'p');
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::thread writer([&] {
+        for (size_t pos = 0; pos < message.size();) {
+            ssize_t n = write(fds[1], message.data() + pos, message.size() - pos);
+            ASSERT_GT(n, 0);
+            pos += n;
+        }
+        close(fds[1]);
+    });
+    EXPECT_EQ(sha1::hash_fd(fds[0]), sha1::hash_string(message));
+    writer.join();
+    close(fds[0]);
+}
+
+TEST(SHA1Tests, HashStreamChunkBoundaries) {
+    // Sizes around CHUNK_SIZE exercise the short final read in hash_stream_raw.
+    for (size_t len : {sha1::CHUNK_SIZE - 1, sha1::CHUNK_SIZE, sha1::CHUNK_SIZE + 1, 3 * sha1::CHUNK_SIZE}) {
+        std::string message(len, 'b');
+        std::istringstream iss(message);
+        EXPECT_EQ(sha1::hash_stream(iss), sha1::hash_string(message)) << "length " << len;
+    }
+}
+
+TEST(SHA1Tests, PortableBackendAlwaysSupported) {
+    EXPECT_TRUE(sha1::backend_supported(sha1::Backend::Portable));
+    EXPECT_TRUE(sha1::backend_supported(sha1::active_backend()));
+}
+
+TEST_P(SHA1Tests, BackendDigestTest) {
+    const auto& [message, expected_hash] = GetParam();
+    for_each_backend([&](sha1::Backend) {
+        EXPECT_EQ(sha1::hash_string(message), expected_hash);
+    });
+}
+
+TEST(SHA1Tests, BackendsAgreeOnManyBlocks) {
+    std::string message;
+    for (size_t i = 0; i < 64 * 257 + 13; i++) {
+        message.push_back(static_cast<char>((i * 2654435761u) >> 13));
+    }
+    std::string expected;
+    for_each_backend([&](sha1::Backend backend) {
+        if (backend == sha1::Backend::Portable) {
+            expected = sha1::hash_string(message); // Portable always runs first
+        }
+        EXPECT_EQ(sha1::hash_string(message), expected);
+    });
+}
+
+TEST(SHA1Tests, HashManyTestVectors) {
+    std::vector<std::span<const std::byte>> messages;
+    for (const auto& [message, _] : testing::test_vector) {
+        messages.push_back(std::as_bytes(std::span(message.data(), message.size())));
+    }
+    for_each_batch_backend([&](sha1::BatchBackend) {
+        std::vector<sha1::Digest> digests(messages.size());
+        sha1::hash_many(messages, digests);
+        for (size_t i = 0; i < digests.size(); i++) {
+            EXPECT_EQ(sha1::to_hex(digests[i]), testing::test_vector[i].second);
+        }
+    });
+}
+
+TEST(SHA1Tests, HashManyMixedLengths) {
+    // Lengths straddle the one/two/three block padding cases and leave lanes idle at the end.
+    std::vector<std::string> storage;
+    for (size_t len = 0; len < 300; len += 7) {
+        storage.push_back(std::string(len, static_cast<char>('a' + len % 26)));
+    }
+    storage.push_back(std::string(5000, 'z'));
+    std::vector<std::span<const std::byte>> messages;
+    for (const auto& s : storage) {
+        messages.push_back(std::as_bytes(std::span(s.data(), s.size())));
+    }
+
+    for_each_batch_backend([&](sha1::BatchBackend) {
+        std::vector<sha1::Digest> digests(messages.size());
+        sha1::hash_many(messages, digests);
+        for (size_t i = 0; i < digests.size(); i++) {
+            EXPECT_EQ(sha1::to_hex(digests[i]), sha1::hash_string(storage[i])) << "length " << storage[i].size();
+        }
+    });
+}
+
+TEST(SHA1Tests, HashManySizeMismatch) {
+    std::vector<std::span<const std::byte>> messages(3);
+    std::vector<sha1::Digest> digests(2);
+    EXPECT_THROW(sha1::hash_many(messages, digests), std::invalid_argument);
+    sha1::hash_many({}, {}); // Nothing to do is fine
+}
+
+TEST(SHA1Tests, HashFilesInOrder) {
+    TempDir dir("boogie_hash_files_test");
+    std::vector<std::string> paths;
+    std::vector<std::string> contents;
+    for (size_t i = 0; i < 40; i++) {
+        // Sizes go up and down so the largest-first schedule differs from input order.
+        contents.push_back(std::string((i * 7919) % 20000, static_cast<char>('a' + i % 26)));
+        paths.push_back(dir.write("f" + std::to_string(i), contents.back()));
+    }
+    paths.push_back((dir.root / "missing").string());
+
+    size_t expected_index = 0;
+    sha1::hash_files(paths, 4, [&](size_t i, const sha1::FileResult& result) {
+        EXPECT_EQ(i, expected_index++);
+        if (i < contents.size()) {
+            ASSERT_TRUE(result.ok()) << result.error;
+            EXPECT_EQ(sha1::to_hex(result.raw_hash), sha1::hash_string(contents[i]));
+        } else {
+            EXPECT_FALSE(result.ok());
+        }
+    });
+    EXPECT_EQ(expected_index, paths.size());
+}
+
+TEST(SHA1Tests, ExportImportResumes) {
+    std::string message;
+    for (size_t i = 0; i < 1000; i++) {
+        message.push_back(static_cast<char>((i * 2654435761u) >> 11));
+    }
+    const std::string expected = sha1::hash_string(message);
+    const auto bytes = std::as_bytes(std::span(message.data(), message.size()));
+
+    // Checkpoint at every split point, including block boundaries and mid-block tails.
+    for (size_t split = 0; split <= bytes.size(); split += 7) {
+        sha1::Hasher first;
+        first.update(bytes.first(split));
+        std::array<std::byte, sha1::STATE_MAX_BYTES> state;
+        size_t len = first.export_state(state);
+        EXPECT_EQ(len, sha1::STATE_HEADER_BYTES + split % sha1::SHA1_BLOCK_BYTES);
+
+        sha1::Hasher resumed = sha1::Hasher::from_state(std::span(state).first(len));
+        resumed.update(bytes.subspan(split));
+        EXPECT_EQ(sha1::to_hex(resumed.finalize()), expected) << "split at " << split;
+    }
+}
+
+TEST(SHA1Tests, ExportedStateLayout) {
+    // Pinned so the format cannot drift: a state written today must import on any future build.
+    sha1::Hasher hasher;
+    hasher.update("abc");
+    std::array<std::byte, sha1::STATE_MAX_BYTES> state;
+    size_t len = hasher.export_state(state);
+    const unsigned char expected[] = {
+        'B', 'S', 'H', '1', 1, 3, 0, 0,
+        0x67, 0x45, 0x23, 0x01, 0xEF, 0xCD, 0xAB, 0x89, 0x98, 0xBA, 0xDC, 0xFE, 0x10, 0x32, 0x54, 0x76,
+        0xC3, 0xD2, 0xE1, 0xF0,
+        0, 0, 0, 0, 0, 0, 0, 3,
+        'a', 'b', 'c',
+    };
+    ASSERT_EQ(len, sizeof(expected));
+    EXPECT_EQ(std::memcmp(state.data(), expected, len), 0);
+}
+
+TEST(SHA1Tests, ImportRejectsMalformedState) {
+    sha1::Hasher hasher;
+    hasher.update("abc");
+    std::array<std::byte, sha1::STATE_MAX_BYTES> state;
+    const size_t len = hasher.export_state(state);
+
+    EXPECT_THROW(sha1::import_state(std::span(state).first(len - 1)), std::invalid_argument);
+    EXPECT_THROW(sha1::import_state(std::span(state).first(len + 1)), std::invalid_argument);
+    auto broken = state;
+    broken[0] = std::byte{'X'};
+    EXPECT_THROW(sha1::import_state(std::span(broken).first(len)), std::invalid_argument);
+    broken = state;
+    broken[4] = std::byte{2}; // Future version
+    EXPECT_THROW(sha1::import_state(std::span(broken).first(len)), std::invalid_argument);
+    broken = state;
+    broken[35] = std::byte{4}; // Length disagrees with the tail
+    EXPECT_THROW(sha1::import_state(std::span(broken).first(len)), std::invalid_argument);
+
+    std::array<std::byte, 10> small;
+    EXPECT_THROW(hasher.export_state(small), std::invalid_argument);
+}
+
+TEST(SHA1Tests, ForkPrecomputedPrefix) {
+    sha1::Hasher prefix;
+    prefix.update(std::string(1000, 'p'));
+    for (const std::string& suffix : std::vector<std::string>{"", "a", "suffix", std::string(200, 's')}) {
+        sha1::Hasher fork = prefix;
+        fork.update(suffix);
+        EXPECT_EQ(sha1::to_hex(fork.finalize()), sha1::hash_string(std::string(1000, 'p') + suffix));
+    }
+}
+
+TEST(SHA1Tests, OneShotHash) {
+    for (const auto& [message, expected] : testing::test_vector) {
+        EXPECT_EQ(sha1::to_hex(sha1::hash(message)), expected);
+        EXPECT_EQ(sha1::hash(std::as_bytes(std::span(message.data(), message.size()))), sha1::hash(message));
+    }
+}
+
+TEST(SHA1Tests, HexRoundTrip) {
+    const sha1::Digest digest = sha1::hash("boogie");
+    std::array<char, sha1::HEX_LEN> buf;
+    sha1::to_hex(digest, buf);
+    const std::string_view hex(buf.data(), buf.size());
+    EXPECT_EQ(hex, sha1::to_hex(digest));
+    EXPECT_EQ(sha1::from_hex(hex), digest);
+
+    std::string upper(hex);
+    for (char& c : upper) {
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+    EXPECT_EQ(sha1::from_hex(upper), digest);
+
+    // Every byte value survives the round trip.
+    std::array<std::byte, 256> all;
+    for (size_t i = 0; i < all.size(); i++) {
+        all[i] = static_cast<std::byte>(i);
+    }
+    std::string encoded(2 * all.size(), '\0');
+    EXPECT_EQ(hex::encode(all, encoded.data()), encoded.data() + encoded.size());
+    std::array<std::byte, 256> decoded;
+    EXPECT_TRUE(hex::decode(encoded, decoded));
+    EXPECT_EQ(decoded, all);
+}
+
+TEST(SHA1Tests, HexRejectsMalformed) {
+    const std::string good = sha1::to_hex(sha1::hash("boogie"));
+    EXPECT_FALSE(sha1::from_hex(good.substr(1)).has_value());
+    EXPECT_FALSE(sha1::from_hex(good + "0").has_value());
+    EXPECT_FALSE(sha1::from_hex("").has_value());
+    for (char bad : {'g', 'G', ' ', '\0', '/', ':', '@', '`', '\xff'}) {
+        std::string s = good;
+        s[17] = bad;
+        EXPECT_FALSE(sha1::from_hex(s).has_value()) << static_cast<int>(bad);
+    }
+}
+
+TEST(SHA1Tests, ToStringMatchesToHex) {
+    const std::array<uint32_t, 5> raw = {0x01234567, 0x89abcdef, 0x00000000, 0xffffffff, 0x0000000a};
+    EXPECT_EQ(utils::toString(raw.data(), raw.size()), "0123456789abcdef00000000ffffffff0000000a");
+    EXPECT_EQ(sha1::to_hex(raw), "0123456789abcdef00000000ffffffff0000000a");
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <hash/sha1_tree.h>
+#include <test/test_util.h>
+
+#include <filesystem>
+#include <sstream>
+#include <string>
+
+using namespace hash;
+
+namespace {
+    std::string make_input(size_t size) {
+        std::string s(size, '\0');
+        uint32_t x = 12345;
+        for (char& c : s) {
+            x = x * 1664525 + 1013904223;
+            c = static_cast<char>(x >> 24);
+        }
+        return s;
+    }
+
+    // Straight from the format description, one SHA-1 at a time.
+    sha1::Digest reference_leaf(std::string_view leaf) {
+        return sha1::to_digest(sha1::Hasher().update(std::string_view("\0", 1)).update(leaf).finalize());
+    }
+
+    sha1::Digest reference_node(const sha1::Digest& l, const sha1::Digest& r) {
+        return sha1::to_digest(sha1::Hasher().update("\x01").update(l).update(r).finalize());
+    }
+}
+
+TEST(SHA1TreeTests, EmptyInputIsOneEmptyLeaf) {
+    auto tree = sha1::tree::hash_tree({});
+    ASSERT_EQ(tree.leaves.size(), 1);
+    EXPECT_EQ(tree.root, reference_leaf(""));
+    EXPECT_NE(tree.root, sha1::to_digest(sha1::Hasher().finalize())); // Domain separated from plain SHA-1
+}
+
+TEST(SHA1TreeTests, MatchesReferenceShape) {
+    // Three leaves and a bit: ((L0 L1) (L2 L3)) with a short L3, and five leaves where L4 is promoted.
+    const size_t L = sha1::tree::LEAF_SIZE;
+    const std::string four = make_input(3 * L + 100);
+    std::string_view v(four);
+    sha1::Digest l[4] = {reference_leaf(v.substr(0, L)), reference_leaf(v.substr(L, L)),
+                         reference_leaf(v.substr(2 * L, L)), reference_leaf(v.substr(3 * L))};
+    auto tree = sha1::tree::hash_tree(bytes(four), 3);
+    ASSERT_EQ(tree.leaves.size(), 4);
+    EXPECT_EQ(tree.root, reference_node(reference_node(l[0], l[1]), reference_node(l[2], l[3])));
+
+    const std::string five = make_input(5 * L);
+    std::string_view f(five);
+    sha1::Digest m[5];
+    for (size_t i = 0; i < 5; i++) {
+        m[i] = reference_leaf(f.substr(i * L, L));
+    }
+    auto top = reference_node(reference_node(m[0], m[1]), reference_node(m[2], m[3]));
+    EXPECT_EQ(sha1::tree::hash_tree(bytes(five), 2).root, reference_node(top, m[4]));
+}
+
+TEST(SHA1TreeTests, IndependentOfThreadsAndSplits) {
+    const std::string input = make_input(9 * sha1::tree::LEAF_SIZE + 12345);
+    const auto expected = sha1::tree::hash_tree(bytes(input), 1);
+    for (unsigned threads : {2u, 4u, 7u}) {
+        EXPECT_EQ(sha1::tree::hash_tree(bytes(input), threads).root, expected.root) << threads << " threads";
+    }
+    for (size_t step : {size_t{1000}, sha1::tree::LEAF_SIZE - 1, 3 * sha1::tree::LEAF_SIZE + 1}) {
+        sha1::tree::TreeHasher hasher(3);
+        for (size_t pos = 0; pos < input.size(); pos += step) {
+            hasher.update(bytes(input).subspan(pos, std::min(step, input.size() - pos)));
+        }
+        auto tree = hasher.finalize();
+        EXPECT_EQ(tree.root, expected.root) << "step " << step;
+        EXPECT_EQ(tree.leaves, expected.leaves);
+    }
+    std::istringstream iss(input);
+    EXPECT_EQ(sha1::tree::hash_stream(iss, 2), sha1::to_hex(expected.root));
+}
+
+TEST(SHA1TreeTests, HashFile) {
+    const std::string input = make_input(2 * sha1::tree::LEAF_SIZE + 1);
+    TempDir dir("boogie_tree_test");
+    const std::string path = dir.write("input", input);
+    EXPECT_EQ(sha1::tree::hash_file(path, 4), sha1::to_hex(sha1::tree::hash_tree(bytes(input)).root));
+    EXPECT_THROW(sha1::tree::hash_file("/nonexistent/boogie/file"), std::runtime_error);
+}
+
+TEST(SHA1TreeTests, VerifyRange) {
+    const size_t L = sha1::tree::LEAF_SIZE;
+    const std::string input = make_input(4 * L + 7);
+    const auto tree = sha1::tree::hash_tree(bytes(input));
+    EXPECT_EQ(sha1::tree::root_of(tree.leaves), tree.root);
+
+    EXPECT_TRUE(sha1::tree::verify_range(bytes(input).subspan(L, 2 * L), L, tree.leaves));
+    EXPECT_TRUE(sha1::tree::verify_range(bytes(input).subspan(3 * L), 3 * L, tree.leaves));
+    EXPECT_FALSE(sha1::tree::verify_range(bytes(input).subspan(L, 2 * L), 0, tree.leaves));
+    EXPECT_FALSE(sha1::tree::verify_range(bytes(input).subspan(L + 1, L), L + 1, tree.leaves));
+    EXPECT_FALSE(sha1::tree::verify_range(bytes(input).subspan(L, L + 5), L, tree.leaves)); // Short leaf mid-input
+
+    std::string corrupt = input;
+    corrupt[2 * L + 17] ^= 1;
+    EXPECT_FALSE(sha1::tree::verify_range(bytes(corrupt).subspan(L, 2 * L), L, tree.leaves));
+    EXPECT_THROW(sha1::tree::root_of({}), std::invalid_argument);
+}
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include <hash/sha1.h>
+#include <hash/sha256.h>
+#include <util/file.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace hash;
+
+namespace {
+    // FIPS 180-4 examples, NIST's long messages and lengths around the padding boundaries.
+    const std::vector<std::pair<std::string, std::string>> vectors = {
+        {"", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+        {"abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+        {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+         "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+        {"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+         "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1"},
+        {"The quick brown fox jumps over the lazy dog",
+         "d7a8fbb307d7809469ca9abcb0082e4f8d5651e46d3cdb762d02d0bf37c9e592"},
+        {std::string(55, 'a'), "9f4390f8d30c2dd92ec9f095b65e2b9ae9b0a925a5258e241c9f1e910f734318"},
+        {std::string(56, 'a'), "b35439a4ac6f0948b6d6f9e3c6af0f5f590ce20f1bde7090ef7970686ec6738a"},
+        {std::string(63, 'a'), "7d3e74a05d7db15bce4ad9ec0658ea98e3f06eeecf16b4c6fff2da457ddc2f34"},
+        {std::string(64, 'a'), "ffe054fe7ae0cb6dc65c3af9b61d5209f439851db43d0ba5997337df154668eb"},
+        {std::string(119, 'a'), "31eba51c313a5c08226adf18d4a359cfdfd8d2e816b13f4af952f7ea6584dcfb"},
+    };
+
+    // Runs `fn` once under every compression backend this CPU supports, then puts the default back.
+    template<typename Fn>
+    void for_each_backend(Fn fn) {
+        const auto original = sha256::active_backend();
+        for (auto backend : {sha256::Backend::Portable, sha256::Backend::ShaNi}) {
+            if (!sha256::set_backend(backend)) {
+                continue;
+            }
+            SCOPED_TRACE(sha256::backend_name(backend));
+            fn(backend);
+        }
+        sha256::set_backend(original);
+    }
+
+    // Digests as the engine sees them, for the compile-time checks below.
+    constexpr sha256::Digest sha256_words(std::array<uint32_t, 8> words) {
+        return md::to_digest<sha256::Traits>(words);
+    }
+}
+
+// Both functions evaluate entirely at compile time, multi-block messages included.
+static_assert(sha256::hash("abc") == sha256_words({0xba7816bf, 0x8f01cfea, 0x414140de, 0x5dae2223,
+                                                   0xb00361a3, 0x96177a9c, 0xb410ff61, 0xf20015ad}));
+static_assert(sha256::hash("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")
+              == sha256_words({0x248d6a61, 0xd20638b8, 0xe5c02693, 0x0c3e6039,
+                               0xa33ce459, 0x64ff2167, 0xf6ecedd4, 0x19db06c1}));
+static_assert(sha1::hash("abc") == sha1::to_digest({0xa9993e36, 0x4706816a, 0xba3e2571, 0x7850c26c, 0x9cd0d89d}));
+static_assert(sha1::hash("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")
+              == sha1::to_digest({0x84983e44, 0x1c3bd26e, 0xbaae4aa1, 0xf95129e5, 0xe54670f1}));
+
+TEST(SHA256Tests, TestVectors) {
+    for_each_backend([](sha256::Backend) {
+        for (const auto& [message, expected] : vectors) {
+            EXPECT_EQ(sha256::hash_string(message), expected) << "length " << message.size();
+        }
+    });
+}
+
+TEST(SHA256Tests, MillionAs) {
+    const std::string message(1000000, 'a');
+    for_each_backend([&](sha256::Backend) {
+        EXPECT_EQ(sha256::hash_string(message), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    });
+}
+
+TEST(SHA256Tests, UpdateSplitPoints) {
+    const std::string& message = vectors[3].first;
+    const auto bytes = std::as_bytes(std::span(message.data(), message.size()));
+    for (size_t split = 0; split <= bytes.size(); split++) {
+        sha256::Hasher hasher;
+        hasher.update(bytes.first(split)).update(bytes.subspan(split));
+        EXPECT_EQ(sha256::to_hex(hasher.finalize()), vectors[3].second) << "split at " << split;
+    }
+}
+
+TEST(SHA256Tests, BackendsAgreeOnManyBlocks) {
+    std::string message;
+    for (size_t i = 0; i < 64 * 257 + 13; i++) {
+        message.push_back(static_cast<char>((i * 2654435761u) >> 13));
+    }
+    std::string expected;
+    for_each_backend([&](sha256::Backend backend) {
+        if (backend == sha256::Backend::Portable) {
+            expected = sha256::hash_string(message); // Portable always runs first
+        }
+        EXPECT_EQ(sha256::hash_string(message), expected);
+    });
+}
+
+TEST(SHA256Tests, CompileTimeMatchesRunTime) {
+    constexpr sha256::Digest at_compile_time = sha256::hash("boogie");
+    const std::string message = "boogie";
+    EXPECT_EQ(sha256::hash(std::as_bytes(std::span(message.data(), message.size()))), at_compile_time);
+
+    // A message longer than one block exercises the engine's buffering in a constant expression.
+    constexpr sha1::Digest sha1_at_compile_time = sha1::hash(
+        "It's super natu ral deeeee light. It's super natu ral deeeee light. It's super natu ral deeeee light.");
+    EXPECT_EQ(sha1::to_hex(sha1_at_compile_time), sha1::hash_string(
+        "It's super natu ral deeeee light. It's super natu ral deeeee light. It's super natu ral deeeee light."));
+}
+
+TEST(SHA256Tests, PaddingMatchesSHA1Layout) {
+    // Same 64-bit big-endian length field as SHA-1, so the padding must agree byte for byte.
+    for (size_t len : {0, 1, 55, 56, 63, 64, 100}) {
+        std::vector<std::byte> a(md::padded_len<sha256::Traits>(len));
+        std::vector<std::byte> b(sha1::padded_len(len));
+        ASSERT_EQ(a.size(), b.size());
+        EXPECT_EQ(md::pad<sha256::Traits>(a, len, 3), sha1::sha1_pad(b, len, 3));
+        EXPECT_EQ(std::memcmp(a.data() + len, b.data() + len, a.size() - len), 0) << "length " << len;
+    }
+}
+
+TEST(SHA256Tests, HashFile) {
+    const std::string current_dir = std::filesystem::path(__FILE__).parent_path().string();
+    EXPECT_EQ(sha256::hash_file(current_dir + "/assets/bee_movie.txt"),
+              "27052339536a08543f16b5fa0deb4ce554a70b697b27ee0143302d7e6ec4fe2f");
+    EXPECT_THROW(sha256::hash_file("/nonexistent/boogie/file"), std::runtime_error);
+}
+
+TEST(SHA256Tests, HashFdPipe) {
+    std::string message(utils::READ_BUFFER_SIZE * 2 + 17, 'p');
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::thread writer([&] {
+        for (size_t pos = 0; pos < message.size();) {
+            ssize_t n = write(fds[1], message.data() + pos, message.size() - pos);
+            ASSERT_GT(n, 0);
+            pos += n;
+        }
+        close(fds[1]);
+    });
+    EXPECT_EQ(sha256::hash_fd(fds[0]), sha256::hash_string(message));
+    writer.join();
+    close(fds[0]);
+}
+
+TEST(SHA256Tests, HexRoundTrip) {
+    const sha256::Digest digest = sha256::hash("boogie");
+    EXPECT_EQ(sha256::from_hex(sha256::to_hex(digest)), digest);
+    EXPECT_FALSE(sha256::from_hex(sha1::to_hex(sha1::hash("boogie"))).has_value());
+}
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <hash/sha1.h>
+#include <hash/sha256.h>
+#include <hash/stats.h>
+#include <test/test_util.h>
+
+#include <filesystem>
+#include <string>
+#include <thread>
+
+using namespace hash;
+
+TEST(StatsTests, CountsBytesAndBlocks) {
+    if (!stats::ENABLED) {
+        GTEST_SKIP() << "built without BOOGIE_STATS";
+    }
+    stats::reset();
+    sha1::hash_string(std::string(1000, 'x'));
+    auto s = stats::snapshot();
+    EXPECT_EQ(s[stats::Counter::BytesHashed], 1000);
+    EXPECT_EQ(s.blocks(), 16); // 15 whole blocks plus 40 bytes of tail padded into one more
+}
+
+TEST(StatsTests, HashManyCountsOnlyRealBlocks) {
+    if (!stats::ENABLED) {
+        GTEST_SKIP() << "built without BOOGIE_STATS";
+    }
+    // 1, 2 and 16 blocks once padded: the wide kernels run 16 times with most lanes idle.
+    const std::string a(10, 'a'), b(100, 'b'), c(1000, 'c');
+    std::span<const std::byte> messages[3] = {bytes(a), bytes(b), bytes(c)};
+    sha1::Digest out[3];
+    for_each_batch_backend([&](sha1::BatchBackend) {
+        stats::reset();
+        sha1::hash_many(messages, out);
+        auto s = stats::snapshot();
+        EXPECT_EQ(s[stats::Counter::BytesHashed], 1110);
+        EXPECT_EQ(s.blocks(), 19);
+    });
+}
+
+TEST(StatsTests, FinishedThreadsStillCount) {
+    if (!stats::ENABLED) {
+        GTEST_SKIP() << "built without BOOGIE_STATS";
+    }
+    stats::reset();
+    std::thread([] { sha1::hash_string(std::string(64, 'x')); }).join();
+    std::thread([] { sha1::hash_string(std::string(64, 'y')); }).join();
+    EXPECT_EQ(stats::snapshot()[stats::Counter::BytesHashed], 128);
+}
+
+TEST(StatsTests, FileReadsSplitReadAndCompute) {
+    if (!stats::ENABLED) {
+        GTEST_SKIP() << "built without BOOGIE_STATS";
+    }
+    TempDir dir("boogie_stats_test");
+    const std::string path = dir.write("input", std::string(100000, 's'));
+    stats::reset();
+    sha1::hash_file(path);
+
+    auto s = stats::snapshot();
+    EXPECT_EQ(s[stats::Counter::BytesHashed], 100000);
+    EXPECT_GE(s[stats::Counter::Chunks], 1);
+    EXPECT_GT(s[stats::Counter::ComputeNanos], 0);
+}
+
+TEST(StatsTests, Json) {
+    stats::Snapshot s;
+    s.values[static_cast<size_t>(stats::Counter::BytesHashed)] = 42;
+    s.values[static_cast<size_t>(stats::Counter::BlocksShaNi)] = 3;
+    s.values[static_cast<size_t>(stats::Counter::ReadNanos)] = 1500000000;
+    const std::string json = stats::to_json(s);
+    EXPECT_EQ(json.front(), '{');
+    EXPECT_EQ(json.back(), '}');
+    EXPECT_NE(json.find("\"bytes_hashed\":42,"), std::string::npos) << json;
+    EXPECT_NE(json.find("\"blocks_compressed\":3,"), std::string::npos) << json;
+    EXPECT_NE(json.find("\"sha-ni\":3"), std::string::npos) << json;
+    EXPECT_NE(json.find("\"read_seconds\":1.500000"), std::string::npos) << json;
+    EXPECT_NE(json.find("\"sha1_backend\":\"" + std::string(sha1::backend_name(sha1::active_backend())) + "\""),
+              std::string::npos) << json;
+    EXPECT_NE(json.find("\"sha256_backend\":\"" + std::string(sha256::backend_name(sha256::active_backend())) + "\""),
+              std::string::npos) << json;
+}
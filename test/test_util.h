@@ -0,0 +1,71 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <gtest/gtest.h>
+
+#include <hash/sha1.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+
+// Helpers shared by the test files.
+
+inline std::span<const std::byte> bytes(const std::string& s) {
+    return std::as_bytes(std::span(s.data(), s.size()));
+}
+
+// A fresh directory under the system temp directory, removed again at the end of the test.
+struct TempDir {
+    std::filesystem::path root;
+
+    explicit TempDir(const std::string& name) : root(std::filesystem::temp_directory_path() / name) {
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root);
+    }
+    ~TempDir() { std::filesystem::remove_all(root); }
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    // Writes `content` to `name` under root, creating directories on the way, and returns its full path.
+    std::string write(const std::string& name, std::string_view content) const {
+        const auto path = root / name;
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream(path, std::ios::binary).write(content.data(), static_cast<std::streamsize>(content.size()));
+        return path.string();
+    }
+};
+
+// Runs `fn` once under every compression backend this CPU supports, then puts the default back.
+template<typename Fn>
+void for_each_backend(Fn fn) {
+    const auto original = hash::sha1::active_backend();
+    for (auto backend : {hash::sha1::Backend::Portable, hash::sha1::Backend::ShaNi}) {
+        if (!hash::sha1::set_backend(backend)) {
+            continue;
+        }
+        SCOPED_TRACE(hash::sha1::backend_name(backend));
+        fn(backend);
+    }
+    hash::sha1::set_backend(original);
+}
+
+// Same as for_each_backend() but for the hash_many() kernels.
+template<typename Fn>
+void for_each_batch_backend(Fn fn) {
+    const auto original = hash::sha1::active_batch_backend();
+    for (auto backend : {hash::sha1::BatchBackend::Scalar, hash::sha1::BatchBackend::Avx2,
+                         hash::sha1::BatchBackend::Avx512}) {
+        if (!hash::sha1::set_backend(backend)) {
+            continue;
+        }
+        SCOPED_TRACE(hash::sha1::backend_name(backend));
+        fn(backend);
+    }
+    hash::sha1::set_backend(original);
+}
+
+#endif // TEST_UTIL_H
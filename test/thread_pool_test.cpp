@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+
+#include <util/thread_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST(ThreadPoolTests, RunsEveryTask) {
+    utils::ThreadPool pool(4);
+    std::vector<int> hits(1000, 0);
+    utils::parallel_for(pool, hits.size(), [&](size_t i) { hits[i]++; });
+    for (int h : hits) {
+        EXPECT_EQ(h, 1);
+    }
+}
+
+TEST(ThreadPoolTests, IdleWorkersStealFromBusyOnes) {
+    utils::ThreadPool pool(4);
+    std::atomic<int> done = 0;
+    // One task queues a pile of work on its own deque and then blocks; the rest of the pool must drain it.
+    pool.submit([&] {
+        for (int i = 0; i < 100; i++) {
+            pool.submit([&] { done++; });
+        }
+        while (done < 100) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    pool.wait();
+    EXPECT_EQ(done, 100);
+}
+
+TEST(ThreadPoolTests, WaitWithNothingSubmitted) {
+    utils::ThreadPool pool(2);
+    pool.wait();
+    EXPECT_EQ(pool.size(), 2);
+}
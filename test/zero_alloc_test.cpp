@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <hash/hex.h>
+#include <hash/hmac_sha1.h>
+#include <hash/sha1.h>
+#include <util/counting_new.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Counts the heap allocations made by the thread that asked for it, for the whole test binary.
+namespace {
+    thread_local bool counting = false;
+    std::atomic<size_t> counted = 0;
+
+    void note() {
+        if (counting) {
+            counted++;
+        }
+    }
+
+    // Number of allocations `fn` makes on this thread.
+    template<typename Fn>
+    size_t allocations(Fn fn) {
+        counted = 0;
+        counting = true;
+        fn();
+        counting = false;
+        return counted;
+    }
+}
+
+void utils::on_allocation() noexcept {
+    note();
+}
+
+using namespace hash;
+
+TEST(ZeroAllocTests, CounterSeesAllocations) {
+    static std::vector<std::string> kept; // Kept so the allocation cannot be optimised away
+    EXPECT_GE(allocations([] { kept.emplace_back(100, 'x'); }), 1);
+}
+
+TEST(ZeroAllocTests, HotPathDoesNotAllocate) {
+    std::vector<std::byte> message(10000, std::byte{0x61});
+    const hmac_sha1::Key key(std::as_bytes(std::span("key", 3)));
+    std::array<char, sha1::HEX_LEN> hex_buf;
+    sha1::Digest digest = sha1::hash(message); // Warm up backend detection and per-thread counters
+
+    const size_t n = allocations([&] {
+        for (size_t len : {0, 1, 55, 56, 64, 1000, 10000}) {
+            digest = sha1::hash(std::span(message).first(len));
+            sha1::to_hex(digest, hex_buf);
+            ASSERT_TRUE(hex::decode(std::string_view(hex_buf.data(), hex_buf.size()), digest));
+
+            sha1::Hasher hasher;
+            hasher.update(std::span(message).first(len / 2)).update(std::span(message).subspan(len / 2, len - len / 2));
+            digest = sha1::to_digest(hasher.finalize());
+
+            digest = key.sign(std::span(message).first(len));
+        }
+        std::span<const std::byte> messages[3] = {message, std::span(message).first(10), {}};
+        sha1::Digest out[3];
+        sha1::hash_many(messages, out);
+    });
+    EXPECT_EQ(n, 0);
+    EXPECT_EQ(sha1::to_hex(digest), sha1::to_hex(key.sign(message)));
+}
+
+TEST(ZeroAllocTests, FirstHashOnNewThreadDoesNotAllocate) {
+    std::vector<std::byte> message(1000, std::byte{0x61});
+    sha1::Digest digest = sha1::hash(message); // Backend detection happens once per process
+    size_t n = 0;
+    std::thread([&] { n = allocations([&] { digest = sha1::hash(message); }); }).join();
+    EXPECT_EQ(n, 0); // Attaching the thread's stats counters included
+    EXPECT_EQ(digest, sha1::hash(message));
+}